@@ -20,6 +20,8 @@
 
 #include <qlineedit.h>
 #include <qcombobox.h>
+#include <qcheckbox.h>
+#include <qvalidator.h>
 #include <kdebug.h>
 #include <kstandarddirs.h>
 
@@ -70,7 +72,10 @@ SessionEditor::SessionEditor(QWidget * parent, const char *name)
 
   connect(fontCombo, SIGNAL(activated(int)), this, SLOT(sessionModified()));
   connect(flowCombo, SIGNAL(activated(int)), this, SLOT(sessionModified()));
+  speedCombo->setValidator(new QIntValidator(50, 20000000, speedCombo));
   connect(speedCombo, SIGNAL(activated(int)), this, SLOT(sessionModified()));
+  connect(speedCombo, SIGNAL(textChanged(const QString&)), this, SLOT(sessionModified()));
+  connect(autoBaudCheck, SIGNAL(toggled(bool)), this, SLOT(sessionModified()));
   connect(parityCombo, SIGNAL(activated(int)), this, SLOT(sessionModified()));
   connect(bitsCombo, SIGNAL(activated(int)), this, SLOT(sessionModified()));
   connect(stopBitsCombo, SIGNAL(activated(int)), this, SLOT(sessionModified()));
@@ -221,11 +226,11 @@ void SessionEditor::readSession(int num)
 	i = co->readUnsignedNumEntry("FlowControl",0);
 	flowCombo->setCurrentItem(i);
 
-	static const int32_t baudrates[] = { 300, 600, 1200, 2400, 4800, 9600, 19200, 38400, 57600, 115200 };
+	// The combo is editable: rates not in the list are shown as typed,
+	// TETty passes them to the driver as custom rates.
 	k = co->readUnsignedNumEntry("Speed",115200);
-	for(i = 0; i < sizeof(baudrates)/sizeof(int32_t); i++)
-	  if ( baudrates[i] == k ) break;
-	speedCombo->setCurrentItem(i);
+	speedCombo->setCurrentText(QString::number(k));
+	autoBaudCheck->setChecked(co->readBoolEntry("AutoBaud", false));
 
 	i = co->readUnsignedNumEntry("Parity",0);
 	parityCombo->setCurrentItem(i);
@@ -330,6 +335,7 @@ void SessionEditor::saveCurrent()
     co->writeEntry("Font",fontCombo->currentItem()-1);
   co->writeEntry("FlowControl",flowCombo->currentItem());
   co->writeEntry("Speed",speedCombo->currentText());
+  co->writeEntry("AutoBaud",autoBaudCheck->isChecked());
   co->writeEntry("Parity",parityCombo->currentItem());
   co->writeEntry("Bits",bitsCombo->currentItem()+5);
   co->writeEntry("StopBits",stopBitsCombo->currentItem()+1);
@@ -0,0 +1,247 @@
+/*
+    This file is part of Konsole, an X terminal.
+    Copyright (C) 2007 Diego Pettenò <flameeyes@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+#include <sys/types.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+#include <qsocketnotifier.h>
+
+#include <kdebug.h>
+
+#include "TEAutoBaud.h"
+#include "TETty.h"
+
+// Candidates tried when none are given, most common first. Eight
+// samples of SAMPLE_MSECS keep the whole probe at about half a second.
+static const int defaultCandidates[] = {
+  115200, 9600, 57600, 38400, 19200, 230400, 460800, 921600
+};
+
+// Time spent listening at each candidate; slow candidates get at
+// least the time of MIN_SAMPLE characters.
+#define SAMPLE_MSECS 60
+
+// Characters needed before a sample counts at all.
+#define MIN_SAMPLE 8
+
+// A sample this clean and this large ends the probe early.
+#define LOCK_SCORE 0.95
+#define LOCK_SAMPLE 32
+
+// How much a framing or parity error counts against a sample,
+// relative to a good character.
+#define ERROR_WEIGHT 4
+
+TEAutoBaud::TEAutoBaud(TETty *tty, int fd)
+  : QObject(tty)
+  , m_tty(tty)
+  , m_fd(fd)
+  , m_savedSpeed(0)
+  , m_notifier(0)
+  , m_current(0)
+  , m_bestSpeed(0)
+  , m_bestScore(0)
+  , m_sampleLen(0)
+{
+  connect( &m_timer, SIGNAL(timeout()), this, SLOT(sampleDone()) );
+}
+
+TEAutoBaud::~TEAutoBaud()
+{
+  delete m_notifier;
+}
+
+bool TEAutoBaud::start(const QValueVector<int> &candidates)
+{
+  if ( tcgetattr(m_fd, &m_saved) < 0 )
+  {
+    kdWarning(1211) << "TEAutoBaud: cannot read the line settings: " << strerror(errno) << endl;
+    return false;
+  }
+  m_savedSpeed = m_tty->actualSpeed();
+
+  m_candidates = candidates;
+  if ( m_candidates.isEmpty() )
+    for ( size_t i = 0; i < sizeof(defaultCandidates)/sizeof(defaultCandidates[0]); i++ )
+      m_candidates.push_back(defaultCandidates[i]);
+
+  // Mark framing and parity errors in the data as \377 \0 <char>; a
+  // real \377 then arrives doubled.
+  struct termios options = m_saved;
+  options.c_iflag &= ~(IGNPAR | ISTRIP | IGNBRK | BRKINT | IXON | IXOFF);
+  options.c_iflag |= INPCK | PARMRK;
+  tcsetattr(m_fd, TCSANOW, &options);
+
+  m_notifier = new QSocketNotifier(m_fd, QSocketNotifier::Read, this);
+  connect( m_notifier, SIGNAL(activated(int)), this, SLOT(readable()) );
+
+  m_current = 0;
+  m_bestSpeed = 0;
+  m_bestScore = 0;
+  nextCandidate();
+  return true;
+}
+
+void TEAutoBaud::nextCandidate()
+{
+  if ( m_current >= m_candidates.size() )
+  {
+    finish();
+    return;
+  }
+
+  int speed = m_candidates[m_current];
+  m_tty->setSpeed(speed);
+  tcflush(m_fd, TCIFLUSH);
+  m_sampleLen = 0;
+
+  // 10 bits per character with start and stop bit
+  int msecs = QMAX(SAMPLE_MSECS, MIN_SAMPLE * 10 * 1000 / speed);
+  m_timer.start(msecs, true);
+}
+
+void TEAutoBaud::readable()
+{
+  while ( m_sampleLen < (int)sizeof(m_sample) )
+  {
+    int r = ::read(m_fd, m_sample + m_sampleLen, sizeof(m_sample) - m_sampleLen);
+    if ( r < 0 && errno == EINTR ) continue;
+    if ( r <= 0 ) break;
+    m_sampleLen += r;
+  }
+
+  // that's plenty, no need to wait for the timer
+  if ( m_sampleLen == (int)sizeof(m_sample) )
+  {
+    m_timer.stop();
+    sampleDone();
+  }
+}
+
+void TEAutoBaud::sampleDone()
+{
+  int chars;
+  double s = score(m_sample, m_sampleLen, &chars);
+  int speed = m_candidates[m_current];
+  kdDebug(1211) << "TEAutoBaud: " << speed << " baud: " << chars << " characters, score " << s << endl;
+
+  if ( chars >= MIN_SAMPLE && s > m_bestScore )
+  {
+    m_bestScore = s;
+    m_bestSpeed = speed;
+  }
+
+  if ( chars >= LOCK_SAMPLE && s >= LOCK_SCORE )
+  {
+    finish();
+    return;
+  }
+
+  m_current++;
+  nextCandidate();
+}
+
+void TEAutoBaud::finish()
+{
+  m_timer.stop();
+  delete m_notifier;
+  m_notifier = 0;
+
+  tcsetattr(m_fd, TCSANOW, &m_saved);
+
+  // Half the sample being text is not much, but noise from a wrong
+  // speed scores well below zero.
+  int speed = m_bestScore > 0.5 ? m_bestSpeed : 0;
+  if ( speed )
+    m_tty->setSpeed(speed);
+  else if ( m_savedSpeed > 0 )
+    m_tty->setSpeed(m_savedSpeed);
+
+  emit finished(speed);
+}
+
+double TEAutoBaud::score(const unsigned char *data, int len, int *bytes)
+{
+  int chars = 0;     // characters seen, errors included
+  int good = 0;      // printable ASCII and complete UTF-8 sequences
+  int errors = 0;    // framing and parity errors, breaks
+  int need = 0;      // continuation bytes still expected
+  int seq = 0;       // bytes of the UTF-8 sequence so far
+
+  int i = 0;
+  while ( i < len )
+  {
+    int c = data[i];
+    if ( c == 0377 )
+    {
+      if ( i+1 < len && data[i+1] == 0377 )
+      {
+        // a real \377, never valid in text
+        chars++;
+        need = seq = 0;
+        i += 2;
+        continue;
+      }
+      if ( i+2 < len && data[i+1] == 0 )
+      {
+        chars++;
+        errors++;
+        need = seq = 0;
+        i += 3;
+        continue;
+      }
+      break; // mark cut off at the end of the sample
+    }
+
+    chars++;
+    i++;
+
+    if ( need )
+    {
+      if ( (c & 0xc0) == 0x80 )
+      {
+        seq++;
+        if ( !--need )
+          good += seq;
+        continue;
+      }
+      need = seq = 0; // broken sequence, look at c afresh
+    }
+
+    if ( c < 0x80 )
+    {
+      if ( (c >= 0x20 && c < 0x7f) || c == '\r' || c == '\n' || c == '\t' ||
+           c == '\b' || c == 033 )
+        good++;
+    }
+    else if ( c >= 0xc2 && c <= 0xdf ) { need = 1; seq = 1; }
+    else if ( c >= 0xe0 && c <= 0xef ) { need = 2; seq = 1; }
+    else if ( c >= 0xf0 && c <= 0xf4 ) { need = 3; seq = 1; }
+  }
+
+  *bytes = chars;
+  if ( !chars )
+    return 0;
+  return double(good - ERROR_WEIGHT * errors) / chars;
+}
+
+#include "TEAutoBaud.moc"
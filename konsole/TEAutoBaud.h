@@ -0,0 +1,96 @@
+/*
+    This file is part of Konsole, an X terminal.
+    Copyright (C) 2007 Diego Pettenò <flameeyes@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+/*! \file TEAutoBaud.h
+    \brief Line speed detection for TETty.
+*/
+
+#ifndef TEAUTOBAUD_H
+#define TEAUTOBAUD_H
+
+#include <termios.h>
+
+#include <qobject.h>
+#include <qtimer.h>
+#include <qvaluevector.h>
+
+class QSocketNotifier;
+class TETty;
+
+/*!
+    Finds the speed a device is sending at by listening to the line at a
+    number of candidate speeds in turn.
+
+    Each sample is taken with PARMRK set, so that framing and parity
+    errors show up in the data, and scored by how much of it looks like
+    text: printable ASCII, valid UTF-8, and no errors. The best scoring
+    candidate wins. A device that sends nothing can't be detected; the
+    line is then left at the speed it had.
+*/
+class TEAutoBaud : public QObject
+{
+Q_OBJECT
+
+public:
+    TEAutoBaud(TETty *tty, int fd);
+    ~TEAutoBaud();
+
+    /*!
+        starts listening at \a candidates, or the common rates if
+        empty. Returns false if the line settings cannot be read.
+    */
+    bool start(const QValueVector<int> &candidates = QValueVector<int>());
+
+    /*!
+        scores a sample read with PARMRK set: 1 for clean text, 0 or
+        less for noise. \a bytes is set to the number of characters
+        in the sample, errors included.
+    */
+    static double score(const unsigned char *data, int len, int *bytes);
+
+signals:
+    /*! emitted when done, with the detected speed or 0 */
+    void finished(int speed);
+
+private slots:
+    void readable();
+    void sampleDone();
+
+private:
+    void nextCandidate();
+    void finish();
+
+    TETty *m_tty;
+    int m_fd;
+    struct termios m_saved;
+    int m_savedSpeed;
+    QSocketNotifier *m_notifier;
+    QTimer m_timer;
+
+    QValueVector<int> m_candidates;
+    uint m_current;
+    int m_bestSpeed;
+    double m_bestScore;
+
+    unsigned char m_sample[4096];
+    int m_sampleLen;
+};
+
+#endif // TEAUTOBAUD_H
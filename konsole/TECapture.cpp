@@ -0,0 +1,718 @@
+/*
+    This file is part of Konsole, an X terminal.
+    Copyright (C) 2007 Diego Pettenò <flameeyes@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+
+#include <qfile.h>
+
+#include <kdebug.h>
+
+#ifdef QT_THREAD_SUPPORT
+#include <qthread.h>
+#endif
+
+#include "TECapture.h"
+#include "TEClock.h"
+
+// An index entry is added whenever this much traffic or time passed
+// since the previous one, and the entries are written out in batches.
+#define INDEX_INTERVAL_BYTES (256*1024)
+#define INDEX_INTERVAL_USEC  1000000ULL
+#define INDEX_BATCH          64
+
+// Data staged but not yet on disk. Beyond this the disk is clearly not
+// keeping up, and further data is dropped and accounted in a Gap record.
+#define MAX_STAGED (64*1024*1024)
+
+// Without threads the staged data is written out synchronously in
+// blocks of this size.
+#define SYNC_WRITE_SIZE (64*1024)
+
+static inline void put32(char *p, unsigned int v)
+{
+  for (int i = 0; i < 4; i++, v >>= 8)
+    p[i] = char(v & 0xff);
+}
+
+static inline void put64(char *p, unsigned long long v)
+{
+  for (int i = 0; i < 8; i++, v >>= 8)
+    p[i] = char(v & 0xff);
+}
+
+static inline unsigned int get32(const char *p)
+{
+  const unsigned char *u = (const unsigned char*)p;
+  return u[0] | (u[1] << 8) | (u[2] << 16) | ((unsigned int)u[3] << 24);
+}
+
+static inline unsigned long long get64(const char *p)
+{
+  return get32(p) | ((unsigned long long)get32(p + 4) << 32);
+}
+
+#ifdef QT_THREAD_SUPPORT
+/*
+   Swaps the staging buffers and writes the full one out, so record()
+   only ever holds the lock for a memcpy.
+*/
+class TECaptureThread : public QThread
+{
+public:
+  TECaptureThread(TECaptureWriter *writer) : m_writer(writer), m_stop(false) {}
+  void stop();
+
+protected:
+  virtual void run();
+
+private:
+  TECaptureWriter *m_writer;
+  bool m_stop; // protected by the writer's lock
+};
+
+void TECaptureThread::stop()
+{
+  m_writer->m_lock.lock();
+  m_stop = true;
+  m_writer->m_wake.wakeOne();
+  m_writer->m_lock.unlock();
+}
+
+void TECaptureThread::run()
+{
+  TECaptureWriter *w = m_writer;
+  for (;;)
+  {
+    w->m_lock.lock();
+    while ( w->m_staging->isEmpty() && !m_stop )
+      w->m_wake.wait(&w->m_lock);
+    if ( w->m_staging->isEmpty() )
+    {
+      w->m_lock.unlock();
+      break;
+    }
+    TERingBuffer *full = w->m_staging;
+    w->m_staging = ( full == &w->m_buffers[0] ) ? &w->m_buffers[1] : &w->m_buffers[0];
+    w->m_lock.unlock();
+
+    w->writeOut(full);
+  }
+}
+#endif
+
+TECaptureWriter::TECaptureWriter()
+  : m_fd(-1)
+  , m_writeError(false)
+  , m_start(0)
+  , m_offset(0)
+  , m_rxBytes(0)
+  , m_txBytes(0)
+  , m_lostBytes(0)
+  , m_pendingLoss(0)
+  , m_index(INDEX_BATCH * TECAPTURE_INDEX_ENTRY_SIZE)
+  , m_indexEntries(0)
+  , m_lastIndex(0)
+  , m_lastEntryTime(0)
+  , m_lastEntryBytes(0)
+{
+  m_staging = &m_buffers[0];
+#ifdef QT_THREAD_SUPPORT
+  m_thread = 0;
+#endif
+}
+
+TECaptureWriter::~TECaptureWriter()
+{
+  close();
+}
+
+/*!
+    Creates \a fileName, truncating an existing file, and starts the
+    capture. Returns false if the file cannot be created.
+*/
+bool TECaptureWriter::open(const QString &fileName)
+{
+  close();
+
+  m_fd = ::open(QFile::encodeName(fileName), O_WRONLY|O_CREAT|O_TRUNC, 0644);
+  if ( m_fd < 0 )
+  {
+    kdWarning(1211) << "TECapture: cannot create " << fileName << ": "
+                    << strerror(errno) << endl;
+    return false;
+  }
+
+  m_fileName = fileName;
+  m_writeError = false;
+  m_start = now();
+  m_rxBytes = m_txBytes = 0;
+  m_lostBytes = m_pendingLoss = 0;
+  m_index.clear();
+  m_indexEntries = 0;
+  m_lastIndex = 0;
+  m_lastEntryTime = 0;
+  m_lastEntryBytes = 0;
+
+  char header[TECAPTURE_HEADER_SIZE];
+  memset(header, 0, sizeof(header));
+  memcpy(header, TECAPTURE_MAGIC, 8);
+  put32(header + 8, TECAPTURE_VERSION);
+  put64(header + 16, m_start);
+  stage(header, sizeof(header));
+  m_offset = sizeof(header);
+
+#ifdef QT_THREAD_SUPPORT
+  m_thread = new TECaptureThread(this);
+  m_thread->start();
+#endif
+  return true;
+}
+
+/*!
+    Writes the pending index and the End record and closes the file.
+*/
+void TECaptureWriter::close()
+{
+  if ( m_fd < 0 ) return;
+
+#ifdef QT_THREAD_SUPPORT
+  m_lock.lock();
+#endif
+  unsigned long long time = now() - m_start;
+  flushIndex(time);
+
+  char end[24];
+  put64(end, m_lastIndex);
+  put64(end + 8, m_rxBytes);
+  put64(end + 16, m_txBytes);
+  putRecord(End, time, end, sizeof(end));
+#ifdef QT_THREAD_SUPPORT
+  m_lock.unlock();
+
+  m_thread->stop();
+  m_thread->wait();
+  delete m_thread;
+  m_thread = 0;
+#endif
+  writeOut(m_staging);
+
+  if ( m_writeError )
+    kdWarning(1211) << "TECapture: " << m_fileName << " is incomplete, writing failed" << endl;
+  if ( m_lostBytes )
+    kdWarning(1211) << "TECapture: " << m_lostBytes << " bytes missing from "
+                    << m_fileName << ", the disk did not keep up" << endl;
+
+  ::close(m_fd);
+  m_fd = -1;
+}
+
+void TECaptureWriter::record(RecordType type, const char *data, int len)
+{
+  if ( m_fd < 0 || len <= 0 ) return;
+
+#ifdef QT_THREAD_SUPPORT
+  m_lock.lock();
+#endif
+  // taken under the lock, so that records of the I/O thread and the
+  // GUI thread are staged in time order
+  unsigned long long time = now() - m_start;
+  if ( m_staging->size() + len > MAX_STAGED )
+  {
+    m_lostBytes += len;
+    m_pendingLoss += len;
+  }
+  else
+  {
+    if ( m_pendingLoss )
+    {
+      char lost[8];
+      put64(lost, m_pendingLoss);
+      putRecord(Gap, time, lost, sizeof(lost));
+      m_pendingLoss = 0;
+    }
+
+    unsigned long long total = m_rxBytes + m_txBytes;
+    if ( m_offset == TECAPTURE_HEADER_SIZE ||
+         total - m_lastEntryBytes >= INDEX_INTERVAL_BYTES ||
+         time - m_lastEntryTime >= INDEX_INTERVAL_USEC )
+      putIndexEntry(time);
+
+    putRecord(type, time, data, len);
+    if ( type == Received )
+      m_rxBytes += len;
+    else
+      m_txBytes += len;
+
+    if ( m_indexEntries >= INDEX_BATCH )
+      flushIndex(time);
+  }
+#ifdef QT_THREAD_SUPPORT
+  m_wake.wakeOne();
+  m_lock.unlock();
+#else
+  if ( m_staging->size() >= SYNC_WRITE_SIZE )
+    writeOut(m_staging);
+#endif
+}
+
+void TECaptureWriter::putRecord(RecordType type, unsigned long long time,
+                                const char *data, size_t len)
+{
+  char header[TECAPTURE_RECORD_HEADER_SIZE];
+  memset(header, 0, sizeof(header));
+  header[0] = char(type);
+  put32(header + 4, len);
+  put64(header + 8, time);
+  stage(header, sizeof(header));
+  stage(data, len);
+  m_offset += sizeof(header) + len;
+}
+
+/*! remembers that the record about to be written starts at \a time */
+void TECaptureWriter::putIndexEntry(unsigned long long time)
+{
+  char entry[TECAPTURE_INDEX_ENTRY_SIZE];
+  put64(entry, time);
+  put64(entry + 8, m_offset);
+  put64(entry + 16, m_rxBytes);
+  put64(entry + 24, m_txBytes);
+  m_index.append(entry, sizeof(entry));
+  m_indexEntries++;
+
+  m_lastEntryTime = time;
+  m_lastEntryBytes = m_rxBytes + m_txBytes;
+}
+
+void TECaptureWriter::flushIndex(unsigned long long time)
+{
+  if ( !m_indexEntries ) return;
+
+  char head[16];
+  put64(head, m_lastIndex);
+  put32(head + 8, m_indexEntries);
+  put32(head + 12, 0);
+
+  unsigned long long offset = m_offset;
+  size_t len = m_index.size();
+
+  char header[TECAPTURE_RECORD_HEADER_SIZE];
+  memset(header, 0, sizeof(header));
+  header[0] = char(Index);
+  put32(header + 4, sizeof(head) + len);
+  put64(header + 8, time);
+  stage(header, sizeof(header));
+  stage(head, sizeof(head));
+  stage(m_index.linearize(), len);
+  m_offset += sizeof(header) + sizeof(head) + len;
+
+  m_lastIndex = offset;
+  m_index.clear();
+  m_indexEntries = 0;
+}
+
+void TECaptureWriter::stage(const char *data, size_t len)
+{
+  m_staging->append(data, len);
+}
+
+/*!
+    Writes \a buffer to the file and empties it. After a write error
+    the capture is only drained, not written any more.
+*/
+void TECaptureWriter::writeOut(TERingBuffer *buffer)
+{
+  while ( !buffer->isEmpty() && !m_writeError )
+  {
+    struct iovec iov[2];
+    int n = buffer->spans(iov);
+    ssize_t r = ::writev(m_fd, iov, n);
+    if ( r < 0 )
+    {
+      if ( errno == EINTR ) continue;
+      m_writeError = true;
+      break;
+    }
+    buffer->consume(r);
+  }
+  buffer->clear();
+}
+
+// Reader ------------------------------------------------------------------ --
+
+// Chunk size used to hand out plain dumps.
+#define PLAIN_CHUNK_SIZE (64*1024)
+
+TECaptureReader::TECaptureReader()
+  : m_map(0)
+  , m_size(0)
+  , m_pos(0)
+  , m_skip(0)
+  , m_plain(true)
+  , m_indexLoaded(false)
+  , m_start(0)
+  , m_rxPos(0)
+{
+}
+
+TECaptureReader::~TECaptureReader()
+{
+  close();
+}
+
+bool TECaptureReader::open(const QString &fileName)
+{
+  close();
+
+  int fd = ::open(QFile::encodeName(fileName), O_RDONLY);
+  if ( fd < 0 )
+  {
+    kdWarning(1211) << "TECapture: cannot open " << fileName << ": "
+                    << strerror(errno) << endl;
+    return false;
+  }
+
+  struct stat st;
+  if ( fstat(fd, &st) < 0 || st.st_size == 0 )
+  {
+    ::close(fd);
+    return false;
+  }
+
+  void *map = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if ( map == MAP_FAILED )
+  {
+    kdWarning(1211) << "TECapture: cannot map " << fileName << ": "
+                    << strerror(errno) << endl;
+    return false;
+  }
+
+  m_map = (const char*)map;
+  m_size = st.st_size;
+  m_plain = !( m_size >= TECAPTURE_HEADER_SIZE &&
+               memcmp(m_map, TECAPTURE_MAGIC, 8) == 0 &&
+               get32(m_map + 8) == TECAPTURE_VERSION );
+  m_start = m_plain ? 0 : get64(m_map + 16);
+  rewind();
+  return true;
+}
+
+void TECaptureReader::close()
+{
+  if ( !m_map ) return;
+
+  munmap((void*)m_map, m_size);
+  m_map = 0;
+  m_size = 0;
+  m_entries.clear();
+  m_indexLoaded = false;
+}
+
+void TECaptureReader::rewind()
+{
+  m_pos = m_plain ? 0 : TECAPTURE_HEADER_SIZE;
+  m_skip = 0;
+  m_rxPos = 0;
+}
+
+/*!
+    Decodes the record at \a pos. Returns false if there is none or it
+    is cut short, which is what the end of an unfinished capture looks
+    like.
+*/
+bool TECaptureReader::readRecord(size_t pos, Chunk *chunk, size_t *end) const
+{
+  if ( pos + TECAPTURE_RECORD_HEADER_SIZE > m_size )
+    return false;
+
+  const char *p = m_map + pos;
+  size_t len = get32(p + 4);
+  if ( len > m_size - pos - TECAPTURE_RECORD_HEADER_SIZE )
+    return false;
+
+  chunk->type = TECaptureWriter::RecordType((unsigned char)p[0]);
+  chunk->time = get64(p + 8);
+  chunk->data = p + TECAPTURE_RECORD_HEADER_SIZE;
+  chunk->len = len;
+  *end = pos + TECAPTURE_RECORD_HEADER_SIZE + len;
+  return true;
+}
+
+bool TECaptureReader::next(Chunk *chunk)
+{
+  if ( !m_map ) return false;
+
+  if ( m_plain )
+  {
+    if ( m_pos >= m_size ) return false;
+    chunk->type = TECaptureWriter::Received;
+    chunk->time = 0;
+    chunk->data = m_map + m_pos;
+    chunk->len = QMIN(m_size - m_pos, (size_t)PLAIN_CHUNK_SIZE);
+    m_pos += chunk->len;
+    m_rxPos += chunk->len;
+    return true;
+  }
+
+  size_t end;
+  while ( readRecord(m_pos, chunk, &end) )
+  {
+    m_pos = end;
+    switch ( chunk->type )
+    {
+    case TECaptureWriter::Received:
+      if ( m_skip )
+      {
+        chunk->data += m_skip;
+        chunk->len -= m_skip;
+        m_skip = 0;
+      }
+      m_rxPos += chunk->len;
+      return true;
+    case TECaptureWriter::Sent:
+    case TECaptureWriter::Gap:
+      return true;
+    default:
+      break; // Index, End and anything newer
+    }
+  }
+  return false;
+}
+
+void TECaptureReader::addIndexRecord(const char *payload, size_t len)
+{
+  if ( len < 16 ) return;
+  unsigned int count = get32(payload + 8);
+  if ( count > (len - 16) / TECAPTURE_INDEX_ENTRY_SIZE )
+    return;
+
+  const char *p = payload + 16;
+  for ( unsigned int i = 0; i < count; i++, p += TECAPTURE_INDEX_ENTRY_SIZE )
+  {
+    IndexEntry e;
+    e.time = get64(p);
+    e.offset = get64(p + 8);
+    e.rxBytes = get64(p + 16);
+    e.txBytes = get64(p + 24);
+    m_entries.push_back(e);
+  }
+}
+
+/*!
+    Collects the index entries, following the chain back from the End
+    record. An unfinished capture has no End record; its Index records
+    are found by walking the file once.
+*/
+void TECaptureReader::loadIndex()
+{
+  if ( m_indexLoaded ) return;
+  m_indexLoaded = true;
+  m_entries.clear();
+
+  Chunk chunk;
+  size_t end;
+  if ( m_size >= TECAPTURE_HEADER_SIZE + TECAPTURE_END_SIZE &&
+       readRecord(m_size - TECAPTURE_END_SIZE, &chunk, &end) &&
+       chunk.type == TECaptureWriter::End && end == m_size )
+  {
+    QValueVector<size_t> chain;
+    unsigned long long offset = get64(chunk.data);
+    while ( offset >= TECAPTURE_HEADER_SIZE && offset < m_size )
+    {
+      Chunk index;
+      if ( !readRecord(offset, &index, &end) || index.type != TECaptureWriter::Index )
+        break;
+      chain.push_back(offset);
+      unsigned long long prev = get64(index.data);
+      if ( prev >= offset ) break; // the chain only goes backwards
+      offset = prev;
+    }
+    for ( int i = chain.size() - 1; i >= 0; i-- )
+    {
+      readRecord(chain[i], &chunk, &end);
+      addIndexRecord(chunk.data, chunk.len);
+    }
+    return;
+  }
+
+  size_t pos = TECAPTURE_HEADER_SIZE;
+  while ( readRecord(pos, &chunk, &end) )
+  {
+    if ( chunk.type == TECaptureWriter::Index )
+      addIndexRecord(chunk.data, chunk.len);
+    pos = end;
+  }
+}
+
+/*! returns the last entry not past \a value, or -1 */
+int TECaptureReader::findEntry(bool byTime, unsigned long long value) const
+{
+  int lo = 0, hi = m_entries.size() - 1, found = -1;
+  while ( lo <= hi )
+  {
+    int mid = (lo + hi) / 2;
+    unsigned long long v = byTime ? m_entries[mid].time : m_entries[mid].rxBytes;
+    if ( v <= value )
+    {
+      found = mid;
+      lo = mid + 1;
+    }
+    else
+      hi = mid - 1;
+  }
+  return found;
+}
+
+bool TECaptureReader::seekTime(unsigned long long time)
+{
+  if ( !m_map || m_plain ) return false;
+
+  loadIndex();
+  rewind();
+  int i = findEntry(true, time);
+  if ( i >= 0 )
+  {
+    m_pos = m_entries[i].offset;
+    m_rxPos = m_entries[i].rxBytes;
+  }
+
+  Chunk chunk;
+  size_t end;
+  while ( readRecord(m_pos, &chunk, &end) && chunk.time < time )
+  {
+    if ( chunk.type == TECaptureWriter::Received )
+      m_rxPos += chunk.len;
+    m_pos = end;
+  }
+  return true;
+}
+
+bool TECaptureReader::seekReceived(unsigned long long offset)
+{
+  if ( !m_map ) return false;
+
+  rewind();
+  if ( m_plain )
+  {
+    if ( offset > m_size ) return false;
+    m_pos = m_rxPos = offset;
+    return true;
+  }
+
+  loadIndex();
+  int i = findEntry(false, offset);
+  if ( i >= 0 )
+  {
+    m_pos = m_entries[i].offset;
+    m_rxPos = m_entries[i].rxBytes;
+  }
+
+  Chunk chunk;
+  size_t end;
+  while ( readRecord(m_pos, &chunk, &end) )
+  {
+    if ( chunk.type == TECaptureWriter::Received )
+    {
+      if ( m_rxPos + chunk.len > offset )
+      {
+        m_skip = offset - m_rxPos;
+        m_rxPos = offset;
+        return true;
+      }
+      m_rxPos += chunk.len;
+    }
+    m_pos = end;
+  }
+  return m_rxPos == offset;
+}
+
+// Playback ---------------------------------------------------------------- --
+
+TECapturePlayback::TECapturePlayback()
+  : m_hasPending(false)
+  , m_speed(1.0)
+  , m_wallStart(0)
+  , m_firstTime(0)
+{
+}
+
+bool TECapturePlayback::open(const QString &fileName, double speed)
+{
+  close();
+  if ( !m_reader.open(fileName) )
+    return false;
+
+  m_speed = speed > 0 ? speed : 0;
+  m_wallStart = now();
+  // the first received data is the playback's zero
+  m_firstTime = nextReceived() ? m_pending.time : 0;
+  return true;
+}
+
+void TECapturePlayback::close()
+{
+  m_reader.close();
+  m_hasPending = false;
+}
+
+bool TECapturePlayback::nextReceived()
+{
+  m_hasPending = false;
+  while ( m_reader.next(&m_pending) )
+    if ( m_pending.type == TECaptureWriter::Received )
+    {
+      m_hasPending = true;
+      break;
+    }
+  return m_hasPending;
+}
+
+/*! capture time up to which the data is due */
+unsigned long long TECapturePlayback::due() const
+{
+  if ( m_speed <= 0 )
+    return ~0ULL;
+  return m_firstTime + (unsigned long long)((now() - m_wallStart) * m_speed);
+}
+
+bool TECapturePlayback::nextDue(TECaptureReader::Chunk *chunk)
+{
+  if ( !m_hasPending || m_pending.time > due() )
+    return false;
+
+  *chunk = m_pending;
+  nextReceived();
+  return true;
+}
+
+int TECapturePlayback::wait() const
+{
+  unsigned long long d = due();
+  if ( !m_hasPending || m_pending.time <= d )
+    return 0;
+  return int((m_pending.time - d) / m_speed / 1000);
+}
@@ -0,0 +1,246 @@
+/*
+    This file is part of Konsole, an X terminal.
+    Copyright (C) 2007 Diego Pettenò <flameeyes@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+/*! \file TECapture.h
+    \brief Raw capture of the data crossing the serial line.
+
+    A capture file starts with a 32 byte header:
+
+    \verbatim
+    char magic[8]        "SKCAPTUR"
+    u32  version         1
+    u32  flags           0
+    u64  start           microseconds since the epoch
+    u64  reserved
+    \endverbatim
+
+    followed by records, each one a 16 byte header and its payload:
+
+    \verbatim
+    u8   type            see TECaptureWriter::RecordType
+    u8   reserved[3]
+    u32  length          payload length
+    u64  time            microseconds since the start of the capture
+    \endverbatim
+
+    Received and Sent records carry the raw bytes. Every now and then an
+    Index record lists where in the file and in the data stream a given
+    time begins; each index points back to the previous one. A clean
+    close appends an End record, which is always the last 40 bytes of
+    the file and points to the last index. Files that lack it (the
+    program died) can still be read by walking the records in order.
+
+    All numbers are little endian.
+*/
+
+#ifndef TECAPTURE_H
+#define TECAPTURE_H
+
+#include <sys/types.h>
+#include <qstring.h>
+#include <qvaluevector.h>
+
+#include "TERingBuffer.h"
+
+#ifdef QT_THREAD_SUPPORT
+#include <qmutex.h>
+#include <qwaitcondition.h>
+#endif
+
+#define TECAPTURE_MAGIC "SKCAPTUR"
+#define TECAPTURE_VERSION 1
+#define TECAPTURE_HEADER_SIZE 32
+#define TECAPTURE_RECORD_HEADER_SIZE 16
+#define TECAPTURE_INDEX_ENTRY_SIZE 32
+#define TECAPTURE_END_SIZE (TECAPTURE_RECORD_HEADER_SIZE + 24)
+
+class TECaptureThread;
+
+/*!
+    Appends the traffic of a line to a capture file.
+
+    record() only copies the data into a staging buffer; the file is
+    written by a background thread, so the GUI thread never waits for
+    the disk. It may be called from the I/O thread as well.
+*/
+class TECaptureWriter
+{
+public:
+    enum RecordType { Received = 1, Sent = 2, Index = 3, Gap = 4, End = 5 };
+
+    TECaptureWriter();
+    ~TECaptureWriter();
+
+    bool open(const QString &fileName);
+    void close();
+    bool isOpen() const { return m_fd >= 0; }
+    QString fileName() const { return m_fileName; }
+
+    /*! appends a Received or Sent record stamped with the current time */
+    void record(RecordType type, const char *data, int len);
+
+    /*! number of data bytes lost because the disk could not keep up */
+    unsigned long long lostBytes() const { return m_lostBytes; }
+
+private:
+    friend class TECaptureThread;
+
+    void putRecord(RecordType type, unsigned long long time,
+                   const char *data, size_t len);
+    void putIndexEntry(unsigned long long time);
+    void flushIndex(unsigned long long time);
+    void stage(const char *data, size_t len);
+    void writeOut(TERingBuffer *buffer);
+
+    QString m_fileName;
+    int m_fd;
+    volatile bool m_writeError;
+
+    unsigned long long m_start;      // microseconds since the epoch
+    unsigned long long m_offset;     // file offset of the next record
+    unsigned long long m_rxBytes;
+    unsigned long long m_txBytes;
+    unsigned long long m_lostBytes;
+    unsigned long long m_pendingLoss;
+
+    // index entries not yet written out
+    TERingBuffer m_index;
+    int m_indexEntries;
+    unsigned long long m_lastIndex;  // offset of the last Index record
+    unsigned long long m_lastEntryTime;
+    unsigned long long m_lastEntryBytes;
+
+    TERingBuffer m_buffers[2];
+    TERingBuffer *m_staging;         // filled by record()
+#ifdef QT_THREAD_SUPPORT
+    QMutex m_lock;                   // protects m_staging
+    QWaitCondition m_wake;
+    TECaptureThread *m_thread;
+#endif
+};
+
+/*!
+    Reads back a capture file written by TECaptureWriter.
+
+    Files without the capture header are treated as a plain dump of
+    received bytes, so anything saved with e.g. cat from the device can
+    be replayed as well. The file is mapped, not read into memory.
+*/
+class TECaptureReader
+{
+public:
+    struct Chunk
+    {
+        TECaptureWriter::RecordType type;
+        unsigned long long time;    // microseconds since the start
+        const char *data;
+        size_t len;
+    };
+
+    TECaptureReader();
+    ~TECaptureReader();
+
+    bool open(const QString &fileName);
+    void close();
+    bool isOpen() const { return m_map != 0; }
+    /*! false if the file is a plain byte dump */
+    bool isCapture() const { return !m_plain; }
+    /*! start of the capture in microseconds since the epoch, 0 for dumps */
+    unsigned long long startTime() const { return m_start; }
+
+    /*!
+        returns the next Received, Sent or Gap record in \a chunk; the
+        data stays valid until the reader is closed. Returns false at
+        the end of the file.
+    */
+    bool next(Chunk *chunk);
+
+    void rewind();
+    /*! positions the reader at the first record at or after \a time */
+    bool seekTime(unsigned long long time);
+    /*! positions the reader at byte \a offset of the received data */
+    bool seekReceived(unsigned long long offset);
+    /*! number of received bytes before the current position */
+    unsigned long long receivedPosition() const { return m_rxPos; }
+
+private:
+    struct IndexEntry
+    {
+        unsigned long long time;
+        unsigned long long offset;
+        unsigned long long rxBytes;
+        unsigned long long txBytes;
+    };
+
+    bool readRecord(size_t pos, Chunk *chunk, size_t *end) const;
+    void loadIndex();
+    void addIndexRecord(const char *payload, size_t len);
+    int findEntry(bool byTime, unsigned long long value) const;
+
+    const char *m_map;
+    size_t m_size;
+    size_t m_pos;
+    size_t m_skip;               // received bytes to drop from the next record
+    bool m_plain;
+    bool m_indexLoaded;
+    unsigned long long m_start;
+    unsigned long long m_rxPos;
+    QValueVector<IndexEntry> m_entries;
+};
+
+/*!
+    Hands out the received data of a capture at its recorded pace. A
+    \a speed of 2 plays twice as fast and so on, 0 plays everything as
+    soon as it is asked for. Plain dumps carry no timing and always
+    play at full speed.
+*/
+class TECapturePlayback
+{
+public:
+    TECapturePlayback();
+
+    bool open(const QString &fileName, double speed = 1.0);
+    void close();
+    bool isOpen() const { return m_reader.isOpen(); }
+    /*! true once all received data has been handed out */
+    bool atEnd() const { return !m_hasPending; }
+
+    /*!
+        returns the next received data in \a chunk if its time has come,
+        false if it has not or there is none left.
+    */
+    bool nextDue(TECaptureReader::Chunk *chunk);
+
+    /*! milliseconds until the next received data is due */
+    int wait() const;
+
+private:
+    bool nextReceived();
+    unsigned long long due() const;
+
+    TECaptureReader m_reader;
+    TECaptureReader::Chunk m_pending;
+    bool m_hasPending;
+    double m_speed;
+    unsigned long long m_wallStart;  // microseconds since the epoch
+    unsigned long long m_firstTime;  // capture time of the first data
+};
+
+#endif // TECAPTURE_H
@@ -0,0 +1,38 @@
+/*
+    This file is part of Konsole, an X terminal.
+    Copyright (C) 2007 Diego Pettenò <flameeyes@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+/*! \file TEClock.h
+    \brief The clock timestamps and timings of the line traffic are taken from.
+*/
+
+#ifndef TECLOCK_H
+#define TECLOCK_H
+
+#include <sys/time.h>
+
+/*! microseconds since the epoch */
+inline unsigned long long now()
+{
+  struct timeval tv;
+  gettimeofday(&tv, 0);
+  return (unsigned long long)tv.tv_sec * 1000000ULL + tv.tv_usec;
+}
+
+#endif // TECLOCK_H
@@ -0,0 +1,206 @@
+/*
+    This file is part of Konsole, an X terminal.
+    Copyright (C) 2007 Diego Pettenò <flameeyes@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+/*! \file TECommon.cpp
+    \brief The table of character styles.
+*/
+
+#include "TECommon.h"
+
+#include <stdlib.h>
+#include <limits.h>
+#include <kdebug.h>
+
+// must be a power of two
+#define CASTYLE_BUCKETS 1024
+
+// As the table fills up colors are reduced in two steps, direct colors
+// to the 256 color palette and then everything to the 16 system colors.
+// The styles made of system colors alone fit in what is left after the
+// second step, so colors are not dropped altogether.
+#define CASTYLE_PALETTE_LIMIT 0x8000
+#define CASTYLE_SYSTEM_LIMIT  0xc000
+
+// The system colors of the default schema, for matching other colors
+// against.
+static const UINT8 system_rgb[16][3] =
+{
+  { 0x00,0x00,0x00 }, { 0xB2,0x18,0x18 }, { 0x18,0xB2,0x18 }, { 0xB2,0x68,0x18 },
+  { 0x18,0x18,0xB2 }, { 0xB2,0x18,0xB2 }, { 0x18,0xB2,0xB2 }, { 0xB2,0xB2,0xB2 },
+  { 0x68,0x68,0x68 }, { 0xFF,0x54,0x54 }, { 0x54,0xFF,0x54 }, { 0xFF,0xFF,0x54 },
+  { 0x54,0x54,0xFF }, { 0xFF,0x54,0xFF }, { 0x54,0xFF,0xFF }, { 0xFF,0xFF,0xFF }
+};
+
+static UINT16 buckets[CASTYLE_BUCKETS];
+
+castyle *castyle::table = castyle::init();
+int castyle::used = 0;
+int castyle::allocated = 0;
+
+castyle *castyle::init()
+{
+  if (table)
+    return table;
+
+  for (int i = 0; i < CASTYLE_BUCKETS; i++)
+    buckets[i] = CASTYLE_NONE;
+
+  allocated = 64;
+  table = (castyle*) malloc(allocated*sizeof(castyle));
+  intern(cacol(CO_DFT,DEFAULT_FORE_COLOR), cacol(CO_DFT,DEFAULT_BACK_COLOR),
+         DEFAULT_RENDITION); // index 0, what ca() refers to
+  return table;
+}
+
+static inline unsigned int hash(cacol f, cacol b, UINT8 r)
+{
+  unsigned int h = f.t ^ (f.u << 3) ^ (f.v << 11) ^ (f.w << 19);
+  h = h*31 + (b.t ^ (b.u << 3) ^ (b.v << 11) ^ (b.w << 19));
+  h = h*31 + r;
+  return (h ^ (h >> 10) ^ (h >> 20)) & (CASTYLE_BUCKETS-1);
+}
+
+static inline int square(int x) { return x*x; }
+
+/*! returns the entry of the 256 color palette closest to the direct color \a c */
+static cacol paletteColor(cacol c)
+{
+  if (c.t != CO_RGB)
+    return c;
+
+  // nearest point of the 6x6x6 color cube, whose levels are 255*i/5
+  int ri = (c.u*5 + 127) / 255, gi = (c.v*5 + 127) / 255, bi = (c.w*5 + 127) / 255;
+  int cube = square(c.u - 51*ri) + square(c.v - 51*gi) + square(c.w - 51*bi);
+
+  // nearest step of the gray ramp, 8, 18 .. 238
+  int step = QMIN(QMAX(((c.u + c.v + c.w)/3 - 3) / 10, 0), 23);
+  int level = step*10 + 8;
+  int gray = square(c.u - level) + square(c.v - level) + square(c.w - level);
+
+  if (gray < cube)
+    return cacol(CO_256, 232 + step);
+  return cacol(CO_256, 16 + 36*ri + 6*gi + bi);
+}
+
+/*! returns the system color closest to the direct or palette color \a c */
+static cacol systemColor(cacol c)
+{
+  int r, g, b;
+  if (c.t == CO_RGB)
+  {
+    r = c.u; g = c.v; b = c.w;
+  }
+  else if (c.t == CO_256 && c.u < 16)
+    return cacol(CO_SYS, c.u);
+  else if (c.t == CO_256 && c.u < 232)
+  {
+    int i = c.u - 16;
+    r = 255*(i/36)/5; g = 255*((i/6)%6)/5; b = 255*(i%6)/5;
+  }
+  else if (c.t == CO_256)
+    r = g = b = (c.u - 232)*10 + 8;
+  else
+    return c;
+
+  int best = 0, bestDist = INT_MAX;
+  for (int i = 0; i < 16; i++)
+  {
+    int d = square(r - system_rgb[i][0]) + square(g - system_rgb[i][1])
+          + square(b - system_rgb[i][2]);
+    if (d < bestDist) { best = i; bestDist = d; }
+  }
+  return cacol(CO_SYS, best);
+}
+
+UINT16 castyle::intern(cacol f, cacol b, UINT8 r)
+{
+  if (!table)
+    init();
+
+  unsigned int h = hash(f, b, r);
+  for (UINT16 s = buckets[h]; s != CASTYLE_NONE; s = table[s].next)
+    if (table[s].f == f && table[s].b == b && table[s].r == r)
+      return s;
+
+  if (used >= CASTYLE_SYSTEM_LIMIT && (f.t > CO_SYS || b.t > CO_SYS))
+  {
+    static bool warned = false;
+    if (!warned)
+      kdWarning(1211) << "Too many character styles, reducing colors to 16." << endl;
+    warned = true;
+    return intern(systemColor(f), systemColor(b), r);
+  }
+
+  if (used >= CASTYLE_PALETTE_LIMIT && (f.t == CO_RGB || b.t == CO_RGB))
+  {
+    static bool warned = false;
+    if (!warned)
+      kdWarning(1211) << "Many character styles, reducing direct colors to 256." << endl;
+    warned = true;
+    return intern(paletteColor(f), paletteColor(b), r);
+  }
+
+  if (used == CASTYLE_NONE)
+  {
+    // Full even without direct colors: keep the rendition at least.
+    static bool warned = false;
+    if (!warned)
+      kdWarning(1211) << "Too many character styles, dropping colors." << endl;
+    warned = true;
+    cacol fg(CO_DFT,DEFAULT_FORE_COLOR);
+    cacol bg(CO_DFT,DEFAULT_BACK_COLOR);
+    if (f == fg && b == bg)
+      return 0;
+    return intern(fg, bg, r);
+  }
+
+  if (used == allocated)
+  {
+    allocated *= 2;
+    table = (castyle*) realloc(table, allocated*sizeof(castyle));
+  }
+
+  castyle &st = table[used];
+  st.f = f;
+  st.b = b;
+  st.r = r;
+  st.rev = CASTYLE_NONE;
+  st.next = buckets[h];
+  buckets[h] = used;
+  return used++;
+}
+
+UINT16 castyle::reversed(UINT16 s)
+{
+  if (table[s].rev == CASTYLE_NONE)
+  {
+    UINT16 rev = intern(table[s].b, table[s].f, table[s].r);
+    table[s].rev = rev; // intern() may have moved the table
+  }
+  return table[s].rev;
+}
+
+UINT16 castyle::rendered(UINT16 s, UINT8 r)
+{
+  const castyle &st = table[s];
+  if ((st.r | r) == st.r)
+    return s;
+  return intern(st.f, st.b, st.r | r);
+}
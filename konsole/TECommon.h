@@ -26,6 +26,7 @@
 #define TECOMMON_H
 
 #include <qcolor.h>
+#include <string.h>
 
 #ifndef UINT8
 typedef unsigned char UINT8;
@@ -181,6 +182,46 @@ inline void cacol::toggleIntensive()
   }
 }
 
+/*! \class castyle
+ *  \brief the colors and rendition of characters.
+ *
+ *  Every combination in use is kept once in a table shared by all
+ *  screens, histories and widgets, and characters refer to it by its
+ *  index there. Index 0 is the default style.
+ *
+ *  The table never shrinks. So that direct colors cannot fill it up,
+ *  colors are reduced to the 256 color palette and then to the system
+ *  colors as it gets crowded.
+*/
+
+#define CASTYLE_NONE 0xffff
+
+class castyle
+{
+public:
+  cacol  f; // foreground color
+  cacol  b; // background color
+  UINT8  r; // rendition
+public:
+  /*! returns the index of the style \a f, \a b, \a r, adding it if new */
+  static UINT16 intern(cacol f, cacol b, UINT8 r);
+  /*! returns the style at index \a s */
+  static const castyle &at(UINT16 s) { return table[s]; }
+  /*! returns the style \a s with the colors swapped */
+  static UINT16 reversed(UINT16 s);
+  /*! returns the style \a s with rendition \a r added */
+  static UINT16 rendered(UINT16 s, UINT8 r);
+  /*! number of styles in the table */
+  static int count() { return used; }
+private:
+  UINT16 rev;  // reversed(), CASTYLE_NONE until looked up
+  UINT16 next; // next style in the same hash bucket
+  static castyle *table;
+  static int used;
+  static int allocated;
+  static castyle *init();
+};
+
 /*! \class ca
  *  \brief a character with rendition attributes.
 */
@@ -188,17 +229,19 @@ inline void cacol::toggleIntensive()
 class ca
 {
 public:
-  inline ca(UINT16 _c = ' ',
+  inline ca() : c(' '), s(0) {}
+  inline ca(UINT16 _c,
             cacol  _f = cacol(CO_DFT,DEFAULT_FORE_COLOR),
             cacol  _b = cacol(CO_DFT,DEFAULT_BACK_COLOR),
             UINT8  _r = DEFAULT_RENDITION)
-       : c(_c), r(_r), f(_f), b(_b) {}
+       : c(_c), s(castyle::intern(_f,_b,_r)) {}
 public:
   UINT16 c; // character
-  UINT8  r; // rendition
-  cacol  f; // foreground color
-  cacol  b; // background color
+  UINT16 s; // style, see castyle
 public:
+  cacol  f() const { return castyle::at(s).f; } // foreground color
+  cacol  b() const { return castyle::at(s).b; } // background color
+  UINT8  r() const { return castyle::at(s).r; } // rendition
   //FIXME: following a hack to cope with various color spaces
   // it brings the rendition pipeline further out of balance,
   // which it was anyway as the result of various additions.
@@ -211,24 +254,37 @@ public:
 
 inline bool operator == (ca a, ca b)
 { 
-  return a.c == b.c && a.f == b.f && a.b == b.b && a.r == b.r;
+  return a.c == b.c && a.s == b.s;
 }
 
 inline bool operator != (ca a, ca b)
 {
-  return a.c != b.c || a.f != b.f || a.b != b.b || a.r != b.r;
+  return a.c != b.c || a.s != b.s;
+}
+
+/*!
+    compares the two cells at \a a with the two at \a b at once.
+*/
+inline bool equalPair(const ca *a, const ca *b)
+{
+  unsigned long long x, y;
+  memcpy(&x, a, sizeof(x));
+  memcpy(&y, b, sizeof(y));
+  return x == y;
 }
 
 inline bool ca::isTransparent(const ColorEntry* base) const
 {
-  return (b.t == CO_DFT) && base[b.u+0+(b.v?BASE_COLORS:0)].transparent
-      || (b.t == CO_SYS) && base[b.u+2+(b.v?BASE_COLORS:0)].transparent;
+  const castyle &st = castyle::at(s);
+  return (st.b.t == CO_DFT) && base[st.b.u+0+(st.b.v?BASE_COLORS:0)].transparent
+      || (st.b.t == CO_SYS) && base[st.b.u+2+(st.b.v?BASE_COLORS:0)].transparent;
 }
 
 inline bool ca::isBold(const ColorEntry* base) const
 {
-  return (f.t == CO_DFT) && base[f.u+0+(f.v?BASE_COLORS:0)].bold 
-      || (f.t == CO_SYS) && base[f.u+2+(f.v?BASE_COLORS:0)].bold; 
+  const castyle &st = castyle::at(s);
+  return (st.f.t == CO_DFT) && base[st.f.u+0+(st.f.v?BASE_COLORS:0)].bold 
+      || (st.f.t == CO_SYS) && base[st.f.u+2+(st.f.v?BASE_COLORS:0)].bold; 
 }
 
 #endif // TECOMMON_H
@@ -0,0 +1,458 @@
+/*
+    This file is part of Konsole, an X terminal.
+    Copyright (C) 2007 Diego Pettenò <flameeyes@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+#include <sys/types.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <stdio.h>
+
+#include <qsocketnotifier.h>
+
+#include <kdebug.h>
+
+#include "TELoopback.h"
+#include "TETransports.h"
+#include "TEClock.h"
+
+// How often the rate limited generator runs, and how much unused
+// allowance it may save up while the session is not keeping up.
+#define TICK_MSECS 10
+#define MAX_CREDIT_MSECS 100
+
+// Amount pushed per tick when there is no rate limit.
+#define FLOOD_CHUNK (64*1024)
+
+// Traffic generator -------------------------------------------------------- --
+
+TETrafficGenerator::TETrafficGenerator(Pattern pattern, unsigned int seed)
+  : m_pattern(pattern)
+  , m_state(seed ? seed : 1)
+  , m_frame(0)
+{
+}
+
+bool TETrafficGenerator::patternFromName(const QString &name, Pattern *pattern)
+{
+  QString n = name.lower();
+  if ( n == "ascii" )       *pattern = Ascii;
+  else if ( n == "ansi" )   *pattern = Ansi;
+  else if ( n == "utf8" || n == "utf-8" ) *pattern = Utf8;
+  else if ( n == "binary" ) *pattern = Binary;
+  else return false;
+  return true;
+}
+
+QString TETrafficGenerator::patternName(Pattern pattern)
+{
+  switch ( pattern )
+  {
+  case Ascii:  return "ascii";
+  case Ansi:   return "ansi";
+  case Utf8:   return "utf8";
+  case Binary: return "binary";
+  }
+  return QString::null;
+}
+
+/*! xorshift, enough for test data and the same everywhere */
+unsigned int TETrafficGenerator::random()
+{
+  m_state ^= m_state << 13;
+  m_state ^= m_state >> 17;
+  m_state ^= m_state << 5;
+  return m_state;
+}
+
+void TETrafficGenerator::generate(TERingBuffer *out, size_t len)
+{
+  size_t target = out->size() + len;
+  while ( out->size() < target )
+  {
+    switch ( m_pattern )
+    {
+    case Ascii:  asciiLine(out); break;
+    case Ansi:   ansiScreen(out); break;
+    case Utf8:   utf8Line(out); break;
+    case Binary: binaryBurst(out); break;
+    }
+    m_frame++;
+  }
+}
+
+/*! a line of printable text, like a log being dumped */
+void TETrafficGenerator::asciiLine(TERingBuffer *out)
+{
+  char line[82];
+  int len = 20 + random() % 60;
+  for ( int i = 0; i < len; i++ )
+    line[i] = ' ' + random() % 95;
+  line[len++] = '\r';
+  line[len++] = '\n';
+  out->append(line, len);
+}
+
+/*!
+    a full screen update the way curses draws one: cursor addressing,
+    colour changes, short runs of text and erase to end of line.
+*/
+void TETrafficGenerator::ansiScreen(TERingBuffer *out)
+{
+  char buf[64];
+  int len;
+
+  out->append("\033[H", 3);
+  for ( int row = 1; row <= 24; row++ )
+  {
+    len = sprintf(buf, "\033[%d;%dH", row, int(1 + random() % 8));
+    out->append(buf, len);
+
+    int runs = 1 + random() % 6;
+    for ( int i = 0; i < runs; i++ )
+    {
+      int bold = random() % 2;
+      int fg = random() % 8;
+      int bg = random() % 8;
+      len = sprintf(buf, "\033[%d;3%d;4%dm", bold, fg, bg);
+      out->append(buf, len);
+      len = 1 + random() % 12;
+      for ( int j = 0; j < len; j++ )
+        buf[j] = 'a' + random() % 26;
+      buf[len++] = ' ';
+      out->append(buf, len);
+    }
+    out->append("\033[0m\033[K", 7);
+  }
+
+  // and a status line scrolled in at the bottom now and then
+  if ( m_frame % 4 == 0 )
+  {
+    len = sprintf(buf, "\033[1;23r\033[23;1H\n\033[r frame %u", m_frame);
+    out->append(buf, len);
+  }
+}
+
+static int encodeUtf8(unsigned int c, char *p)
+{
+  if ( c < 0x80 )
+  {
+    p[0] = c;
+    return 1;
+  }
+  if ( c < 0x800 )
+  {
+    p[0] = 0xc0 | (c >> 6);
+    p[1] = 0x80 | (c & 0x3f);
+    return 2;
+  }
+  p[0] = 0xe0 | (c >> 12);
+  p[1] = 0x80 | ((c >> 6) & 0x3f);
+  p[2] = 0x80 | (c & 0x3f);
+  return 3;
+}
+
+/*! a line mixing scripts, double width characters and combining marks */
+void TETrafficGenerator::utf8Line(TERingBuffer *out)
+{
+  static const unsigned int ranges[][2] = {
+    { 0x0041, 0x007a }, // ASCII letters
+    { 0x00c0, 0x00ff }, // Latin-1
+    { 0x0391, 0x03c9 }, // Greek
+    { 0x0410, 0x044f }, // Cyrillic
+    { 0x4e00, 0x4fff }, // CJK, double width
+    { 0x0300, 0x036f }, // combining diacriticals
+  };
+
+  char buf[3];
+  int count = 10 + random() % 50;
+  for ( int i = 0; i < count; i++ )
+  {
+    int r = random() % 6;
+    if ( r == 5 && i == 0 ) r = 0; // combining marks need a base
+    unsigned int c = ranges[r][0] + random() % (ranges[r][1] - ranges[r][0] + 1);
+    out->append(buf, encodeUtf8(c, buf));
+  }
+  out->append("\r\n", 2);
+}
+
+/*! random bytes, all 256 values */
+void TETrafficGenerator::binaryBurst(TERingBuffer *out)
+{
+  char buf[4096];
+  int len = 1 + random() % sizeof(buf);
+  for ( int i = 0; i < len; i++ )
+    buf[i] = char(random() >> 24);
+  out->append(buf, len);
+}
+
+// Loopback ------------------------------------------------------------------ --
+
+TELoopback::TELoopback(TETrafficGenerator::Pattern pattern, int rate, bool echo,
+                       QObject *parent)
+  : QObject(parent)
+  , m_master(-1)
+  , m_slave(-1)
+  , m_readNotifier(0)
+  , m_writeNotifier(0)
+  , m_pattern(pattern)
+  , m_rate(rate)
+  , m_echo(echo)
+  , m_failed(false)
+  , m_lastTick(0)
+  , m_started(0)
+  , m_credit(0)
+  , m_generator(pattern)
+  , m_sent(0)
+  , m_rxExpect(pattern)
+  , m_received(0)
+  , m_txExpect(pattern)
+  , m_echoed(0)
+{
+  // The slave stays open here as well, so the master does not see a
+  // hangup while the session reopens the line.
+  if ( !TEPtyTransport::openRaw(&m_master, &m_slave, &m_slaveName) )
+  {
+    kdWarning(1211) << "TELoopback: cannot create a pty pair: " << strerror(errno) << endl;
+    return;
+  }
+
+  m_readNotifier = new QSocketNotifier(m_master, QSocketNotifier::Read, this);
+  connect( m_readNotifier, SIGNAL(activated(int)), this, SLOT(masterReadable()) );
+  m_writeNotifier = new QSocketNotifier(m_master, QSocketNotifier::Write, this);
+  m_writeNotifier->setEnabled(false);
+  connect( m_writeNotifier, SIGNAL(activated(int)), this, SLOT(masterWritable()) );
+
+  connect( &m_timer, SIGNAL(timeout()), this, SLOT(tick()) );
+}
+
+TELoopback::~TELoopback()
+{
+  if ( m_master < 0 ) return;
+
+  kdDebug(1211) << "TELoopback: " << status() << endl;
+  delete m_readNotifier;
+  delete m_writeNotifier;
+  ::close(m_master);
+  ::close(m_slave);
+}
+
+void TELoopback::attach(TETransport *tty)
+{
+  if ( m_master < 0 || !tty ) return;
+
+  m_tty = tty;
+  connect( tty, SIGNAL(block_in(const char*,int)), this, SLOT(received(const char*,int)) );
+  if ( m_echo )
+    connect( tty, SIGNAL(lowWatermark()), this, SLOT(tick()) );
+
+  m_started = m_lastTick = now();
+  m_timer.start(TICK_MSECS);
+  tick();
+}
+
+/*! number of bytes the rate allows to send right now */
+size_t TELoopback::budget()
+{
+  unsigned long long t = now();
+  unsigned long long elapsed = t - m_lastTick;
+  m_lastTick = t;
+
+  if ( m_rate <= 0 )
+    return FLOOD_CHUNK;
+
+  m_credit += m_rate * (elapsed / 1e6);
+  double max = m_rate * (MAX_CREDIT_MSECS / 1000.0);
+  if ( m_credit > max )
+    m_credit = max;
+  return size_t(m_credit);
+}
+
+void TELoopback::tick()
+{
+  if ( m_echo )
+    pushToSession();
+  else
+    pushToMaster();
+}
+
+/*! receive mode: writes generated data to the master side */
+void TELoopback::pushToMaster()
+{
+  size_t n = budget();
+  if ( !n ) return;
+
+  if ( m_outgoing.size() < n )
+    m_generator.generate(&m_outgoing, n - m_outgoing.size());
+
+  while ( n )
+  {
+    size_t len;
+    const char *p = m_outgoing.peek(&len);
+    len = QMIN(len, n);
+    ssize_t r = ::write(m_master, p, len);
+    if ( r < 0 )
+    {
+      if ( errno == EINTR ) continue;
+      if ( errno == EAGAIN )
+        m_writeNotifier->setEnabled(true);
+      break;
+    }
+    m_outgoing.consume(r);
+    m_sent += r;
+    m_credit -= r;
+    n -= r;
+  }
+}
+
+/*! echo mode: makes the session send generated data */
+void TELoopback::pushToSession()
+{
+  if ( !m_tty || m_tty->buffer_full() ) return;
+
+  size_t n = budget();
+  if ( !n ) return;
+
+  if ( m_outgoing.size() < n )
+    m_generator.generate(&m_outgoing, n - m_outgoing.size());
+
+  while ( n && !m_tty->buffer_full() )
+  {
+    size_t len;
+    const char *p = m_outgoing.peek(&len);
+    len = QMIN(len, n);
+    m_tty->send_bytes(p, len);
+    m_outgoing.consume(len);
+    m_sent += len;
+    m_credit -= len;
+    n -= len;
+  }
+}
+
+void TELoopback::masterReadable()
+{
+  char buf[16384];
+  for (;;)
+  {
+    ssize_t r = ::read(m_master, buf, sizeof(buf));
+    if ( r < 0 && errno == EINTR ) continue;
+    if ( r <= 0 )
+    {
+      if ( r == 0 || errno != EAGAIN )
+        m_readNotifier->setEnabled(false);
+      break;
+    }
+
+    // In receive mode whatever the session sends (keys typed) is dropped.
+    if ( !m_echo ) continue;
+
+    verify(&m_txExpect, &m_txExpected, &m_echoed, buf, r);
+    m_echoBuffer.append(buf, r);
+  }
+
+  if ( !m_echoBuffer.isEmpty() )
+    masterWritable();
+}
+
+void TELoopback::masterWritable()
+{
+  m_writeNotifier->setEnabled(false);
+
+  while ( !m_echoBuffer.isEmpty() )
+  {
+    size_t len;
+    const char *p = m_echoBuffer.peek(&len);
+    ssize_t r = ::write(m_master, p, len);
+    if ( r < 0 )
+    {
+      if ( errno == EINTR ) continue;
+      if ( errno == EAGAIN )
+        m_writeNotifier->setEnabled(true);
+      return;
+    }
+    m_echoBuffer.consume(r);
+  }
+
+  if ( !m_echo )
+    pushToMaster();
+}
+
+void TELoopback::received(const char *data, int len)
+{
+  verify(&m_rxExpect, &m_rxExpected, &m_received, data, len);
+}
+
+/*!
+    Compares \a data with the next bytes \a generator produces. After the
+    first difference the stream cannot be followed any more, so checking
+    stops there and the offset is reported.
+*/
+bool TELoopback::verify(TETrafficGenerator *generator, TERingBuffer *expected,
+                        unsigned long long *position, const char *data, size_t len)
+{
+  if ( m_failed ) return false;
+
+  if ( expected->size() < len )
+    generator->generate(expected, len - expected->size());
+
+  size_t done = 0;
+  while ( done < len )
+  {
+    size_t avail;
+    const char *p = expected->peek(&avail);
+    avail = QMIN(avail, len - done);
+    if ( memcmp(p, data + done, avail) != 0 )
+    {
+      size_t i = 0;
+      while ( p[i] == data[done + i] )
+        i++;
+      m_failed = true;
+      m_failure = QString("%1 data differs at byte %2 (expected 0x%3, got 0x%4)")
+                  .arg(expected == &m_rxExpected ? "received" : "echoed")
+                  .arg(*position + done + i)
+                  .arg((unsigned char)p[i], 2, 16)
+                  .arg((unsigned char)data[done + i], 2, 16);
+      kdWarning(1211) << "TELoopback: " << m_failure << endl;
+      emit verifyFailed(status());
+      return false;
+    }
+    expected->consume(avail);
+    done += avail;
+  }
+
+  *position += len;
+  return true;
+}
+
+QString TELoopback::status() const
+{
+  double secs = m_started ? (now() - m_started) / 1e6 : 0;
+  double rate = secs > 0 ? m_received / secs / 1024 : 0;
+
+  QString s = QString("%1 %2: %3 bytes sent, %4 received (%5 KB/s)")
+              .arg(TETrafficGenerator::patternName(m_pattern))
+              .arg(m_echo ? "echo" : "receive")
+              .arg(m_sent).arg(m_received).arg(rate, 0, 'f', 1);
+  if ( m_echo )
+    s += QString(", %1 echoed").arg(m_echoed);
+  s += m_failed ? ", FAILED: " + m_failure : QString(", ok");
+  return s;
+}
+
+#include "TELoopback.moc"
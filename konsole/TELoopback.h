@@ -0,0 +1,151 @@
+/*
+    This file is part of Konsole, an X terminal.
+    Copyright (C) 2007 Diego Pettenò <flameeyes@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+/*! \file TELoopback.h
+    \brief Simulated serial device on a pty, for testing without hardware.
+*/
+
+#ifndef TELOOPBACK_H
+#define TELOOPBACK_H
+
+#include <qobject.h>
+#include <qguardedptr.h>
+#include <qtimer.h>
+
+#include "TERingBuffer.h"
+
+class QSocketNotifier;
+class TETransport;
+
+/*!
+    Produces a reproducible byte stream of a given kind. Two generators
+    created with the same pattern and seed produce the same stream,
+    which is how the received data is checked.
+*/
+class TETrafficGenerator
+{
+public:
+    enum Pattern { Ascii, Ansi, Utf8, Binary };
+
+    TETrafficGenerator(Pattern pattern, unsigned int seed = 1);
+
+    /*! appends at least \a len bytes of the stream to \a out */
+    void generate(TERingBuffer *out, size_t len);
+
+    static bool patternFromName(const QString &name, Pattern *pattern);
+    static QString patternName(Pattern pattern);
+
+private:
+    unsigned int random();
+    void asciiLine(TERingBuffer *out);
+    void ansiScreen(TERingBuffer *out);
+    void utf8Line(TERingBuffer *out);
+    void binaryBurst(TERingBuffer *out);
+
+    Pattern m_pattern;
+    unsigned int m_state;
+    unsigned int m_frame;
+};
+
+/*!
+    The master side of a pty pair acting as a serial device.
+
+    A session is opened on slaveName() like on any other device and then
+    attach()ed. In receive mode the generated traffic is written to the
+    session; in echo mode it is sent by the session instead, checked as
+    it arrives on the master side and echoed back like a loopback plug
+    would. Either way the data the session receives is compared with the
+    expected stream, so lost or damaged bytes show up in status().
+
+    Keys typed into the session, and in echo mode any replies of the
+    emulation to the echoed data, are not part of the stream; echo mode
+    is best used with the ascii and utf8 patterns.
+*/
+class TELoopback : public QObject
+{
+Q_OBJECT
+
+public:
+    TELoopback(TETrafficGenerator::Pattern pattern, int rate, bool echo,
+               QObject *parent = 0);
+    ~TELoopback();
+
+    bool isOpen() const { return m_master >= 0; }
+    QString slaveName() const { return m_slaveName; }
+
+    /*! starts the traffic to and from \a tty, a line opened on slaveName() */
+    void attach(TETransport *tty);
+
+    /*! bytes per second, 0 for as fast as the session takes them */
+    void setRate(int rate) { m_rate = rate; }
+
+    QString status() const;
+    bool failed() const { return m_failed; }
+
+signals:
+    /*! emitted the first time the received data differs from the expected */
+    void verifyFailed(const QString &status);
+
+private slots:
+    void tick();
+    void masterReadable();
+    void masterWritable();
+    void received(const char *data, int len);
+
+private:
+    size_t budget();
+    void pushToMaster();
+    void pushToSession();
+    bool verify(TETrafficGenerator *generator, TERingBuffer *expected,
+                unsigned long long *position, const char *data, size_t len);
+
+    int m_master;
+    int m_slave;
+    QString m_slaveName;
+    QSocketNotifier *m_readNotifier;
+    QSocketNotifier *m_writeNotifier;
+    QTimer m_timer;
+    QGuardedPtr<TETransport> m_tty;
+
+    TETrafficGenerator::Pattern m_pattern;
+    int m_rate;
+    bool m_echo;
+    bool m_failed;
+    unsigned long long m_lastTick;   // microseconds since the epoch
+    unsigned long long m_started;
+    double m_credit;                 // bytes allowed by the rate, not yet sent
+
+    TETrafficGenerator m_generator;  // what is sent
+    TERingBuffer m_outgoing;         // generated, not yet written
+    unsigned long long m_sent;
+
+    TETrafficGenerator m_rxExpect;   // what the session should receive
+    TERingBuffer m_rxExpected;
+    unsigned long long m_received;
+
+    TETrafficGenerator m_txExpect;   // echo mode: what the master should read
+    TERingBuffer m_txExpected;
+    unsigned long long m_echoed;
+    TERingBuffer m_echoBuffer;       // read from the session, not yet echoed
+
+    QString m_failure;
+};
+
+#endif // TELOOPBACK_H
@@ -0,0 +1,670 @@
+/*
+    This file is part of Konsole, an X terminal.
+    Copyright (C) 2007 Diego Pettenò <flameeyes@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+/*! \class TEReactor
+
+    With a QSocketNotifier pair per line the event loop rebuilds its
+    select() set and dispatches a notification per line on every
+    wakeup, which does not scale to a window full of busy lines. The
+    reactor takes the threaded lines out of the event loop altogether.
+
+    The worker only moves bytes; it never calls into the sessions, and
+    it does the I/O without holding the lock. The state of the ports is
+    its own; the GUI thread hands it new and removed ports and changed
+    captures under the lock, which the worker picks up once per wakeup,
+    and kicks ports through a lock-free stack. A
+    port is serviced until its descriptor reports EAGAIN or its ring is
+    full or empty, as edge-triggered notification requires, and keeps
+    the readable/writable state it learned until then. A port whose
+    receive ring is full stays readable and is picked up again when the
+    GUI thread kick()s it after making room; the same goes for a port
+    whose transmit ring ran empty.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+#include <poll.h>
+
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
+
+#include <qapplication.h>
+
+#include <kdebug.h>
+
+#include "TEReactor.h"
+#include "TETransport.h"
+#include "TESpscRing.h"
+#include "TECapture.h"
+#include "TEClock.h"
+
+#ifdef QT_THREAD_SUPPORT
+
+#include <qthread.h>
+#include <qwaitcondition.h>
+
+// Descriptors handled per wakeup of the worker thread.
+#define MAX_EVENTS 256
+
+#define TEREACTOR_EVENT (QEvent::User+0x73)
+
+#define te_swap(p, v) __sync_lock_test_and_set((p), (v))
+#define te_cas(p, o, n) __sync_bool_compare_and_swap((p), (o), (n))
+
+struct TEReactorPort
+{
+  TETransport *transport;
+  int readFd;
+  int writeFd;
+  // worker thread only
+  bool readable;                // as far as the worker knows
+  bool writable;
+  bool readDead;                // end of file, don't read any more
+  unsigned long long readAfter; // end of the coalescing window, 0 if none
+  TECaptureWriter *capture;     // the worker's copy of transport->m_capture
+  // lock-free
+  volatile int kicked;          // in m_kicked
+  TEReactorPort *nextKicked;
+  // under m_mutex
+  bool queued;                  // in m_ready
+};
+
+class TEReactorThread : public QThread
+{
+public:
+  TEReactorThread(TEReactor *reactor) : m_reactor(reactor) {}
+
+protected:
+  virtual void run() { m_reactor->run(); }
+
+private:
+  TEReactor *m_reactor;
+};
+
+TEReactor *TEReactor::s_instance = 0;
+
+void TEReactor::cleanup()
+{
+  delete s_instance;
+}
+
+TEReactor *TEReactor::instance()
+{
+  if ( !s_instance )
+  {
+    s_instance = new TEReactor;
+    qAddPostRoutine(cleanup);
+  }
+  return s_instance;
+}
+
+TEReactor::TEReactor()
+  : m_thread(0)
+  , m_epoll(-1)
+  , m_stop(false)
+  , m_portCount(0)
+  , m_kicked(0)
+  , m_pass(0)
+  , m_eventPending(false)
+{
+  if ( pipe(m_wakePipe) < 0 )
+  {
+    kdWarning(1211) << "TEReactor: cannot create wake pipe: " << strerror(errno) << endl;
+    m_wakePipe[0] = m_wakePipe[1] = -1;
+    return;
+  }
+  fcntl(m_wakePipe[0], F_SETFL, O_NONBLOCK);
+  fcntl(m_wakePipe[1], F_SETFL, O_NONBLOCK);
+
+#ifdef HAVE_SYS_EPOLL_H
+  m_epoll = epoll_create(MAX_EVENTS);
+  if ( m_epoll < 0 )
+  {
+    kdWarning(1211) << "TEReactor: epoll_create failed: " << strerror(errno) << endl;
+    return;
+  }
+  struct epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN;
+  ev.data.fd = m_wakePipe[0];
+  epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_wakePipe[0], &ev);
+#endif
+
+  m_thread = new TEReactorThread(this);
+  m_thread->start();
+}
+
+TEReactor::~TEReactor()
+{
+  if ( m_thread )
+  {
+    m_stop = true;
+    char c = 0;
+    ::write(m_wakePipe[1], &c, 1);
+    m_thread->wait();
+    delete m_thread;
+  }
+
+  if ( m_epoll >= 0 )
+    close(m_epoll);
+  if ( m_wakePipe[0] >= 0 )
+  {
+    close(m_wakePipe[0]);
+    close(m_wakePipe[1]);
+  }
+  s_instance = 0;
+}
+
+bool TEReactor::add(TETransport *t)
+{
+  if ( !m_thread ) return false;
+
+  TEReactorPort *port = new TEReactorPort;
+  port->transport = t;
+  port->readFd = t->m_readFd;
+  port->writeFd = t->m_writeFd;
+  port->readable = port->writable = true; // until read() and write() tell otherwise
+  port->readDead = false;
+  port->readAfter = 0;
+  port->capture = t->m_capture;
+  port->kicked = 0;
+  port->nextKicked = 0;
+  port->queued = false;
+
+#ifdef HAVE_SYS_EPOLL_H
+  struct epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN | EPOLLET;
+  if ( port->writeFd == port->readFd )
+    ev.events |= EPOLLOUT;
+  ev.data.fd = port->readFd;
+  bool ok = epoll_ctl(m_epoll, EPOLL_CTL_ADD, port->readFd, &ev) == 0;
+
+  if ( ok && port->writeFd != port->readFd )
+  {
+    ev.events = EPOLLOUT | EPOLLET;
+    ev.data.fd = port->writeFd;
+    if ( epoll_ctl(m_epoll, EPOLL_CTL_ADD, port->writeFd, &ev) < 0 )
+    {
+      epoll_ctl(m_epoll, EPOLL_CTL_DEL, port->readFd, &ev);
+      ok = false;
+    }
+  }
+
+  if ( !ok )
+  {
+    kdWarning(1211) << "TEReactor: cannot add " << t->name() << ": " << strerror(errno) << endl;
+    delete port;
+    return false;
+  }
+#endif
+
+  QMutexLocker lock(&m_mutex);
+  m_added.append(port);
+  m_portCount++;
+  t->m_port = port;
+
+  char c = 0;
+  ::write(m_wakePipe[1], &c, 1);
+  return true;
+}
+
+void TEReactor::remove(TETransport *t)
+{
+  TEReactorPort *port = t->m_port;
+  if ( !port ) return;
+
+  {
+    QMutexLocker lock(&m_mutex);
+
+#ifdef HAVE_SYS_EPOLL_H
+    struct epoll_event ev;
+    epoll_ctl(m_epoll, EPOLL_CTL_DEL, port->readFd, &ev);
+    if ( port->writeFd != port->readFd )
+      epoll_ctl(m_epoll, EPOLL_CTL_DEL, port->writeFd, &ev);
+#endif
+
+    m_recapture.remove(port);
+    m_removed.append(port);
+    sync();
+
+    // the worker may have queued it in the meanwhile
+    m_ready.remove(t);
+    m_portCount--;
+  }
+
+  m_delivering.remove(t);
+  t->m_port = 0;
+  delete port;
+}
+
+/*!
+    Only called by the GUI thread, so remove() cannot run at the same
+    time; the worker pops the whole stack at once.
+*/
+void TEReactor::kick(TETransport *t)
+{
+  TEReactorPort *port = t->m_port;
+  if ( !port || !te_flag_raise(&port->kicked) ) return;
+
+  TEReactorPort *head;
+  do
+  {
+    head = m_kicked;
+    port->nextKicked = head;
+  } while ( !te_cas(&m_kicked, head, port) );
+
+  char c = 0;
+  ::write(m_wakePipe[1], &c, 1);
+}
+
+void TEReactor::requeue(TETransport *t)
+{
+  QMutexLocker lock(&m_mutex);
+
+  TEReactorPort *port = t->m_port;
+  if ( !port ) return;
+
+  queue(port);
+  if ( !m_eventPending )
+  {
+    m_eventPending = true;
+    QApplication::postEvent(this, new QCustomEvent(TEREACTOR_EVENT));
+  }
+}
+
+void TEReactor::setCapture(TETransport *t, TECaptureWriter *capture)
+{
+  QMutexLocker lock(&m_mutex);
+  t->m_capture = capture;
+
+  TEReactorPort *port = t->m_port;
+  if ( !port ) return;
+
+  if ( !m_recapture.contains(port) )
+    m_recapture.append(port);
+  sync();
+}
+
+/*!
+    Wakes the worker and waits until it picked up the requests made so
+    far. Must be called with m_mutex held.
+*/
+void TEReactor::sync()
+{
+  unsigned long pass = m_pass;
+  char c = 0;
+  ::write(m_wakePipe[1], &c, 1);
+  while ( m_pass == pass )
+    m_passed.wait(&m_mutex);
+}
+
+// The worker thread -------------------------------------------------------- --
+
+void TEReactor::run()
+{
+#ifdef HAVE_SYS_EPOLL_H
+  struct epoll_event events[MAX_EVENTS];
+#else
+  QValueVector<struct pollfd> fds;
+#endif
+  QValueList<TEReactorPort*> kicked;
+
+  for (;;)
+  {
+    int timeout = -1;
+    unsigned long long t = now();
+    QValueList<TEReactorPort*>::Iterator it;
+    for ( it = m_waiting.begin(); it != m_waiting.end(); ++it )
+    {
+      int left = (*it)->readAfter > t ? int(((*it)->readAfter - t + 999) / 1000) : 0;
+      if ( timeout < 0 || left < timeout )
+        timeout = left;
+    }
+
+#ifdef HAVE_SYS_EPOLL_H
+    int n = epoll_wait(m_epoll, events, MAX_EVENTS, timeout);
+#else
+    // poll() is level-triggered, so only ask for what the port does
+    // not know yet.
+    fds.clear();
+    struct pollfd pfd;
+    pfd.fd = m_wakePipe[0];
+    pfd.events = POLLIN;
+    fds.push_back(pfd);
+    for ( it = m_ports.begin(); it != m_ports.end(); ++it )
+    {
+      TEReactorPort *port = *it;
+      pfd.fd = port->readFd;
+      pfd.events = 0;
+      if ( !port->readable && !port->readDead )
+        pfd.events |= POLLIN;
+      if ( !port->writable && port->writeFd == port->readFd )
+        pfd.events |= POLLOUT;
+      if ( pfd.events )
+        fds.push_back(pfd);
+      if ( !port->writable && port->writeFd != port->readFd )
+      {
+        pfd.fd = port->writeFd;
+        pfd.events = POLLOUT;
+        fds.push_back(pfd);
+      }
+    }
+
+    int n = poll(&fds[0], fds.size(), timeout) < 0 ? 0 : fds.size();
+#endif
+
+    char dummy[64];
+    while ( ::read(m_wakePipe[0], dummy, sizeof(dummy)) > 0 )
+      ;
+
+    if ( !pickUp(&kicked) ) break;
+
+    t = now();
+    for ( int i = 0; i < n; i++ )
+    {
+#ifdef HAVE_SYS_EPOLL_H
+      int fd = events[i].data.fd;
+      bool in = events[i].events & (EPOLLIN|EPOLLERR|EPOLLHUP);
+      bool out = events[i].events & (EPOLLOUT|EPOLLERR);
+#else
+      int fd = fds[i].fd;
+      bool in = fds[i].revents & (POLLIN|POLLERR|POLLHUP);
+      bool out = fds[i].revents & (POLLOUT|POLLERR);
+#endif
+      // ports removed while we were waiting are gone from m_byFd
+      TEReactorPort *port = fd < (int)m_byFd.size() ? m_byFd[fd] : 0;
+      if ( !port ) continue;
+
+      if ( in && fd == port->readFd )
+        port->readable = true;
+      if ( out && fd == port->writeFd )
+        port->writable = true;
+      service(port, t);
+    }
+
+    for ( it = kicked.begin(); it != kicked.end(); ++it )
+      service(*it, t);
+    kicked.clear();
+
+    // ports whose coalescing window is over
+    for ( it = m_waiting.begin(); it != m_waiting.end(); )
+    {
+      TEReactorPort *port = *it;
+      ++it;
+      if ( port->readAfter <= t )
+        service(port, t);
+    }
+
+    if ( m_served.isEmpty() ) continue;
+
+    QMutexLocker lock(&m_mutex);
+    for ( it = m_served.begin(); it != m_served.end(); ++it )
+      queue(*it);
+    m_served.clear();
+    if ( !m_eventPending )
+    {
+      m_eventPending = true;
+      QApplication::postEvent(this, new QCustomEvent(TEREACTOR_EVENT));
+    }
+  }
+}
+
+/*!
+    Takes over what the GUI thread asked for since the last wakeup:
+    ports added and removed, captures changed and ports kicked, which
+    are appended to \a kicked oldest first. Returns false once the
+    worker has to stop.
+*/
+bool TEReactor::pickUp(QValueList<TEReactorPort*> *kicked)
+{
+  QMutexLocker lock(&m_mutex);
+
+  QValueList<TEReactorPort*>::Iterator it;
+  for ( it = m_added.begin(); it != m_added.end(); ++it )
+  {
+    TEReactorPort *port = *it;
+    int maxFd = QMAX(port->readFd, port->writeFd);
+    if ( (int)m_byFd.size() <= maxFd )
+      m_byFd.resize(maxFd + 1, 0);
+    m_byFd[port->readFd] = port;
+    m_byFd[port->writeFd] = port;
+    m_ports.append(port);
+    // a poll() based worker has not asked about it yet
+    kicked->append(port);
+  }
+  m_added.clear();
+
+  // Clear the flag only after reading the link, the GUI thread may push
+  // the port again as soon as it is clear.
+  TEReactorPort *port = (TEReactorPort*)te_swap(&m_kicked, 0);
+  QValueList<TEReactorPort*>::Iterator at = kicked->end();
+  while ( port )
+  {
+    TEReactorPort *next = port->nextKicked;
+    at = kicked->insert(at, port);
+    te_flag_clear(&port->kicked);
+    port = next;
+  }
+
+  for ( it = m_removed.begin(); it != m_removed.end(); ++it )
+  {
+    port = *it;
+    m_byFd[port->readFd] = 0;
+    m_byFd[port->writeFd] = 0;
+    m_ports.remove(port);
+    m_waiting.remove(port);
+    kicked->remove(port);
+  }
+  m_removed.clear();
+
+  for ( it = m_recapture.begin(); it != m_recapture.end(); ++it )
+    (*it)->capture = (*it)->transport->m_capture;
+  m_recapture.clear();
+
+  m_pass++;
+  m_passed.wakeAll();
+  return !m_stop;
+}
+
+void TEReactor::service(TEReactorPort *port, unsigned long long t)
+{
+  TETransport *transport = port->transport;
+
+  if ( port->readable && !port->readDead )
+  {
+    int coalesce = transport->m_coalesceMsecs;
+    if ( coalesce && !port->readAfter )
+    {
+      // leave the data in the driver for a while
+      port->readAfter = t + coalesce * 1000ULL;
+      m_waiting.append(port);
+    }
+
+    if ( port->readAfter <= t )
+    {
+      if ( port->readAfter )
+      {
+        port->readAfter = 0;
+        m_waiting.remove(port);
+      }
+      if ( serviceRead(port) && te_flag_raise(&transport->m_rxEventPending) )
+        m_served.append(port);
+    }
+  }
+
+  if ( port->writable && serviceWrite(port) && te_flag_raise(&transport->m_txEventPending) )
+    m_served.append(port);
+}
+
+/*!
+    Reads until the driver is empty or the ring is full. Returns true if
+    anything was read or the read failed; errors other than EAGAIN end
+    reading like end of file does, and are left for the GUI thread to
+    report.
+*/
+bool TEReactor::serviceRead(TEReactorPort *port)
+{
+  TETransport *t = port->transport;
+  TESpscRing *ring = t->m_rxRing;
+  size_t total = 0;
+
+  for (;;)
+  {
+    size_t len;
+    char *p = ring->writePointer(&len);
+    if ( !len )
+    {
+      // Re-check after raising the flag, the GUI thread might have
+      // made room in the meanwhile without seeing it.
+      te_flag_raise(&t->m_rxStalled);
+      if ( !ring->writeSpace() )
+        break;
+      te_flag_take(&t->m_rxStalled);
+      continue;
+    }
+
+    ssize_t r = ::read(port->readFd, p, len);
+    t->countRead(r);
+    if ( r < 0 )
+    {
+      if ( errno == EINTR ) continue;
+      port->readable = false;
+      if ( errno != EAGAIN )
+      {
+        port->readDead = true;
+        t->m_rxError = errno;
+        return true;
+      }
+      break;
+    }
+    if ( r == 0 )
+    {
+      port->readable = false;
+      port->readDead = true;
+      break;
+    }
+
+    // stamped when read, not when the GUI thread gets around to it
+    if ( port->capture )
+      port->capture->record(TECaptureWriter::Received, p, r);
+    ring->produce(r);
+    total += r;
+  }
+
+  return total != 0;
+}
+
+/*!
+    Writes until the driver is full or the ring is empty. Returns true
+    if anything was written.
+*/
+bool TEReactor::serviceWrite(TEReactorPort *port)
+{
+  TETransport *t = port->transport;
+  TESpscRing *ring = t->m_txRing;
+  size_t total = 0;
+
+  for (;;)
+  {
+    struct iovec iov[2];
+    int n = ring->readSpans(iov);
+    if ( !n )
+    {
+      te_flag_raise(&t->m_txIdle);
+      if ( !ring->readAvailable() )
+        break;
+      te_flag_take(&t->m_txIdle);
+      continue;
+    }
+
+    ssize_t r = ::writev(port->writeFd, iov, n);
+    t->countWrite(r);
+    if ( r < 0 )
+    {
+      if ( errno == EINTR ) continue;
+      port->writable = false;
+      if ( errno != EAGAIN )
+      {
+        // No more notifications will come for this descriptor; drop
+        // the data rather than letting the queue grow for ever.
+        r = ring->readAvailable();
+        ring->consume(r);
+        total += r;
+      }
+      break;
+    }
+
+    ring->consume(r);
+    total += r;
+  }
+
+  return total != 0;
+}
+
+/*! must be called with m_mutex held */
+void TEReactor::queue(TEReactorPort *port)
+{
+  if ( port->queued ) return;
+
+  port->queued = true;
+  m_ready.append(port->transport);
+}
+
+// The GUI thread ----------------------------------------------------------- --
+
+void TEReactor::customEvent(QCustomEvent *e)
+{
+  if ( e->type() != TEREACTOR_EVENT ) return;
+
+  {
+    QMutexLocker lock(&m_mutex);
+    m_eventPending = false;
+    QValueList<TETransport*>::Iterator it;
+    for ( it = m_ready.begin(); it != m_ready.end(); ++it )
+    {
+      (*it)->m_port->queued = false;
+      m_delivering.append(*it);
+    }
+    m_ready.clear();
+  }
+
+  // remove() takes transports out of m_delivering, so one going away
+  // while an earlier one is handled is not a problem.
+  while ( !m_delivering.isEmpty() )
+  {
+    TETransport *t = m_delivering.first();
+    m_delivering.pop_front();
+    t->serviceEvents();
+  }
+}
+
+#include "TEReactor.moc"
+
+#endif // QT_THREAD_SUPPORT
@@ -0,0 +1,146 @@
+/*
+    This file is part of Konsole, an X terminal.
+    Copyright (C) 2007 Diego Pettenò <flameeyes@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+/*! \file TEReactor.h
+    \brief The I/O thread shared by all threaded transports.
+*/
+
+#ifndef TEREACTOR_H
+#define TEREACTOR_H
+
+#include <config.h>
+
+#include <qobject.h>
+#include <qvaluelist.h>
+#include <qvaluevector.h>
+
+#ifdef QT_THREAD_SUPPORT
+#include <qmutex.h>
+#include <qwaitcondition.h>
+#endif
+
+class TETransport;
+class TECaptureWriter;
+class TEReactorThread;
+struct TEReactorPort;
+
+/*!
+    Services the descriptors of all threaded transports from a single
+    worker thread, with one edge-triggered epoll set where the system
+    has epoll and poll() elsewhere.
+
+    Every iteration handles all ports that became ready, moving data
+    between the descriptors and the rings of the transports. The ports
+    that received data or made room in their transmit ring are then
+    queued, and the GUI thread is woken with a single event for the
+    whole batch, however many ports it contains.
+*/
+class TEReactor : public QObject
+{
+Q_OBJECT
+
+public:
+    /*! the reactor, created and started on first use */
+    static TEReactor *instance();
+
+    /*!
+        starts servicing the descriptors of \a transport. Its rings
+        must be set up already.
+    */
+    bool add(TETransport *transport);
+
+    /*!
+        stops servicing \a transport. Once this returns the worker
+        thread does not touch it any more.
+    */
+    void remove(TETransport *transport);
+
+    /*!
+        tells the worker thread that \a transport has data to send or
+        made room for received data.
+    */
+    void kick(TETransport *transport);
+
+    /*!
+        queues \a transport for the GUI thread again, for received data
+        it did not take in one go.
+    */
+    void requeue(TETransport *transport);
+
+    /*!
+        sets the capture of \a transport, which the worker thread
+        records received data into as it reads it. Once this returns the
+        worker does not touch the old capture any more.
+    */
+    void setCapture(TETransport *transport, TECaptureWriter *capture);
+
+    /*! number of ports serviced at the moment */
+    int ports() const { return m_portCount; }
+
+protected:
+    void customEvent(QCustomEvent *e);
+
+private:
+    TEReactor();
+    ~TEReactor();
+    static void cleanup();
+
+    friend class TEReactorThread;
+    void run();
+    bool pickUp(QValueList<TEReactorPort*> *kicked);
+    void service(TEReactorPort *port, unsigned long long now);
+    bool serviceRead(TEReactorPort *port);
+    bool serviceWrite(TEReactorPort *port);
+    void queue(TEReactorPort *port);
+    void sync();
+
+    static TEReactor *s_instance;
+
+#ifdef QT_THREAD_SUPPORT
+    TEReactorThread *m_thread;
+    QMutex m_mutex;          // the requests and m_ready below
+    QWaitCondition m_passed; // the worker picked up the requests
+#endif
+    int m_epoll;
+    int m_wakePipe[2];
+    volatile bool m_stop;
+    int m_portCount;
+
+    // worker thread only
+    QValueList<TEReactorPort*> m_ports;
+    QValueVector<TEReactorPort*> m_byFd;     // port of a descriptor
+    QValueList<TEReactorPort*> m_waiting;    // coalescing reads
+    QValueList<TEReactorPort*> m_served;     // to be queued for the GUI thread
+
+    TEReactorPort * volatile m_kicked;       // lock-free stack, see kick()
+
+    // requests of the GUI thread, under m_mutex
+    QValueList<TEReactorPort*> m_added;
+    QValueList<TEReactorPort*> m_removed;
+    QValueList<TEReactorPort*> m_recapture;
+    unsigned long m_pass;                    // times the worker picked them up
+
+    QValueList<TETransport*> m_ready;        // to be looked at by the GUI thread
+    bool m_eventPending;
+
+    QValueList<TETransport*> m_delivering;   // GUI thread only, no lock
+};
+
+#endif // TEREACTOR_H
@@ -0,0 +1,260 @@
+/*
+    This file is part of Konsole, an X terminal.
+    Copyright (C) 2007 Diego Pettenò <flameeyes@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+/*! \class TEReplay
+
+    Replay serves two purposes: reproducing what a device sent without
+    the device, and measuring the emulation pipeline on real traffic.
+    Only the received data is replayed; what was sent is skipped.
+*/
+
+#include <qapplication.h>
+#include <qtextcodec.h>
+#include <qvaluevector.h>
+
+#include <kdebug.h>
+
+#include "TEReplay.h"
+#include "TEmuVt102.h"
+#include "TEWidget.h"
+#include "TEUtf8Decoder.h"
+#include "TEHistory.h"
+#include "TEClock.h"
+
+// Data handed to the emulation per event loop iteration when playing
+// at full speed, so that the screen still gets refreshed.
+#define MAX_SPEED_BATCH (256*1024)
+
+// Blocks handed to the emulation between two screen refreshes in the
+// render stage of the benchmark, about what a busy line delivers
+// between two frames.
+#define BENCHMARK_RENDER_INTERVAL (64*1024)
+
+TEReplay::TEReplay(TEmulation *emulation, QObject *parent)
+  : QObject(parent)
+  , m_emulation(emulation)
+  , m_wallStart(0)
+  , m_bytes(0)
+{
+  connect( &m_timer, SIGNAL(timeout()), this, SLOT(feed()) );
+}
+
+TEReplay::~TEReplay()
+{
+  stop();
+}
+
+bool TEReplay::start(const QString &fileName, double speed)
+{
+  stop();
+  if ( !m_playback.open(fileName, speed) )
+    return false;
+
+  m_wallStart = now();
+  m_bytes = 0;
+  m_timer.start(0, true);
+  return true;
+}
+
+void TEReplay::stop()
+{
+  m_timer.stop();
+  m_playback.close();
+}
+
+void TEReplay::finish()
+{
+  double secs = (now() - m_wallStart) / 1e6;
+  kdDebug(1211) << "TEReplay: " << m_bytes << " bytes in " << secs << " s ("
+                << (secs > 0 ? m_bytes / secs / (1024*1024) : 0) << " MB/s)" << endl;
+  stop();
+  emit finished();
+}
+
+void TEReplay::feed()
+{
+  // Everything whose recorded time has come, or a batch at full speed.
+  TECaptureReader::Chunk chunk;
+  size_t batch = 0;
+  while ( batch < MAX_SPEED_BATCH && m_playback.nextDue(&chunk) )
+  {
+    m_emulation->onRcvBlock(chunk.data, chunk.len);
+    m_bytes += chunk.len;
+    batch += chunk.len;
+  }
+
+  if ( m_playback.atEnd() )
+  {
+    finish();
+    return;
+  }
+
+  m_timer.start(m_playback.wait(), true);
+}
+
+// Benchmark --------------------------------------------------------------- --
+
+/*
+   The stages are measured by running the data through a growing part
+   of the pipeline; the history stage is the difference to the run
+   before it:
+
+     decode    the decoder the emulation uses, alone: TEUtf8Decoder
+               for UTF-8, the text codec otherwise
+     emulate   decoding, escape sequence parser and screen updates, with
+               the history switched off; parser and screen work
+               character by character and are not told apart. Decoding
+               is not subtracted, the emulation skips it for runs of
+               ASCII, so the decode figure would not add up.
+     legacy    the same with the escape sequence parser the emulation
+               replaced, if it kept one, to compare the two; when it
+               is the one in use, the new parser is timed instead
+     history   the same with a 10000 line history buffer
+     render    building the screen image and painting it on the shown
+               widget, X server included, timed on its own
+
+   The emulation is reset between the runs.
+*/
+
+static QString stageLine(const char *name, unsigned long long bytes, unsigned long long usecs)
+{
+  double mbs = usecs ? (bytes / (1024.0*1024.0)) / (usecs / 1e6) : 0;
+  return QString("%1 %2 MB/s (%3 ms)\n").arg(name, -10).arg(mbs, 9, 'f', 1).arg(usecs / 1000);
+}
+
+static unsigned long long emulateAll(TEmulation *emulation,
+                                     const QValueVector<TECaptureReader::Chunk> &chunks)
+{
+  emulation->reset();
+  unsigned long long start = now();
+  for ( int i = 0; i < (int)chunks.size(); i++ )
+    emulation->onRcvBlock(chunks[i].data, chunks[i].len);
+  return now() - start;
+}
+
+QString TEReplay::benchmark(const QString &fileName, const QTextCodec *codec,
+                            bool legacyParser, const QSize &size, const QFont &font)
+{
+  TECaptureReader reader;
+  if ( !reader.open(fileName) )
+    return QString::null;
+
+  QValueVector<TECaptureReader::Chunk> chunks;
+  TECaptureReader::Chunk chunk;
+  unsigned long long bytes = 0;
+  while ( reader.next(&chunk) )
+    if ( chunk.type == TECaptureWriter::Received )
+    {
+      chunks.push_back(chunk);
+      bytes += chunk.len;
+    }
+  int n = chunks.size();
+
+  // Nothing is connected to sndBlock(), answers to queries in the
+  // capture go nowhere. The widget is sized in character cells, and the
+  // screens are sized to match in case the widget would not take it.
+  TEWidget widget;
+  widget.setVTFont(font);
+  widget.setFixedSize(size.width(), size.height());
+  TEmuVt102 emulation(&widget);
+  emulation.onImageSizeChange(size.height(), size.width());
+  emulation.setCodec(codec);
+  emulation.setLegacyParser(legacyParser);
+  emulation.setConnect(true);
+
+  // decode
+  unsigned long long start = now();
+  if ( codec->mibEnum() == 106 )
+  {
+    TEUtf8Decoder utf8;
+    QMemArray<unsigned short> ucs;
+    for ( int i = 0; i < n; i++ )
+    {
+      if ( (int)ucs.size() < chunks[i].len + 1 )
+        ucs.resize(chunks[i].len + 1);
+      utf8.decode(chunks[i].data, chunks[i].len, ucs.data());
+    }
+  }
+  else
+  {
+    QTextDecoder *decoder = codec->makeDecoder();
+    for ( int i = 0; i < n; i++ )
+      decoder->toUnicode(chunks[i].data, chunks[i].len);
+    delete decoder;
+  }
+  unsigned long long decode = now() - start;
+
+  // emulate
+  emulation.setHistory(HistoryTypeNone());
+  unsigned long long emulate = emulateAll(&emulation, chunks);
+
+  // legacy
+  emulation.setLegacyParser(!legacyParser);
+  bool hasLegacy = emulation.legacyParser() != legacyParser;
+  unsigned long long other = 0;
+  if ( hasLegacy )
+  {
+    other = emulateAll(&emulation, chunks);
+    emulation.setLegacyParser(legacyParser);
+  }
+
+  // history
+  emulation.setHistory(HistoryTypeBuffer(10000));
+  unsigned long long history = emulateAll(&emulation, chunks);
+
+  // render, on the widget shown so that it really paints
+  widget.show();
+  qApp->processEvents();
+  emulation.reset();
+  unsigned long long render = 0;
+  size_t sinceRefresh = 0;
+  for ( int i = 0; i < n; i++ )
+  {
+    emulation.onRcvBlock(chunks[i].data, chunks[i].len);
+    sinceRefresh += chunks[i].len;
+    if ( sinceRefresh >= BENCHMARK_RENDER_INTERVAL || i == n-1 )
+    {
+      start = now();
+      emulation.showBulk();
+      // scrolling leaves the exposed area to a paint event, and the X
+      // server draws after the request returned
+      qApp->processEvents();
+      QApplication::syncX();
+      render += now() - start;
+      sinceRefresh = 0;
+    }
+  }
+
+  widget.hide();
+
+  QSize screen = emulation.imageSize();
+  QString report = QString("%1: %2 bytes in %3 blocks, %4x%5 %6\n").arg(fileName).arg(bytes).arg(n)
+                   .arg(screen.width()).arg(screen.height()).arg(codec->name());
+  report += stageLine("decode", bytes, decode);
+  report += stageLine("emulate", bytes, emulate);
+  if ( hasLegacy )
+    report += stageLine(legacyParser ? "new parser" : "legacy", bytes, other);
+  report += stageLine("history", bytes, history > emulate ? history - emulate : 0);
+  report += stageLine("render", bytes, render);
+  report += stageLine("total", bytes, history + render);
+  return report;
+}
+
+#include "TEReplay.moc"
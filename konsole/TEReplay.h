@@ -0,0 +1,85 @@
+/*
+    This file is part of Konsole, an X terminal.
+    Copyright (C) 2007 Diego Pettenò <flameeyes@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+#ifndef TEREPLAY_H
+#define TEREPLAY_H
+
+#include <qobject.h>
+#include <qtimer.h>
+
+#include "TECapture.h"
+
+class TEmulation;
+class QTextCodec;
+class QSize;
+class QFont;
+
+/*!
+    Feeds the received data of a capture file (or a plain byte dump)
+    into an emulation, without a line being involved.
+*/
+class TEReplay : public QObject
+{
+Q_OBJECT
+
+public:
+    TEReplay(TEmulation *emulation, QObject *parent = 0);
+    ~TEReplay();
+
+    /*!
+        starts replaying \a fileName. A \a speed of 1 keeps the recorded
+        timing, 2 plays twice as fast and so on; 0 plays as fast as the
+        emulation can take it. Plain dumps carry no timing and always
+        play at full speed.
+    */
+    bool start(const QString &fileName, double speed = 1.0);
+    void stop();
+    bool isRunning() const { return m_playback.isOpen(); }
+
+    /*!
+        pushes the received data of \a fileName through each stage of
+        the emulation pipeline in turn and returns a report with the
+        throughput of every stage. The benchmark runs on an emulation and
+        a widget of its own, which never talk to a line, set up with
+        \a codec, the parser chosen by \a legacyParser and a screen of
+        \a size columns and lines in \a font. The widget is only shown
+        while the painting is timed.
+    */
+    static QString benchmark(const QString &fileName, const QTextCodec *codec,
+                             bool legacyParser, const QSize &size, const QFont &font);
+
+signals:
+    void finished();
+
+private slots:
+    void feed();
+
+private:
+    void finish();
+
+    TEmulation *m_emulation;
+    TECapturePlayback m_playback;
+    QTimer m_timer;
+
+    unsigned long long m_wallStart;  // microseconds since the epoch
+    unsigned long long m_bytes;
+};
+
+#endif // TEREPLAY_H
@@ -0,0 +1,168 @@
+/*
+    This file is part of Konsole, an X terminal.
+    Copyright (C) 2007 Diego Pettenò <flameeyes@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+/*! \class TERingBuffer
+
+    The buffer is a single heap block used as a ring. The capacity is
+    always a power of two, so wrapping is a simple mask.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "TERingBuffer.h"
+
+TERingBuffer::TERingBuffer(size_t initialSize)
+  : buf(0), cap(1), head(0), used(0)
+{
+  while (cap < initialSize)
+    cap <<= 1;
+  buf = (char*)malloc(cap);
+}
+
+TERingBuffer::~TERingBuffer()
+{
+  free(buf);
+}
+
+/*! enlarges the buffer so that at least \a needed bytes fit, linearizing
+    the stored data at the start of the new block.
+*/
+void TERingBuffer::grow(size_t needed)
+{
+  size_t newcap = cap;
+  while (newcap < needed)
+    newcap <<= 1;
+
+  char *newbuf = (char*)malloc(newcap);
+  struct iovec iov[2];
+  int n = spans(iov);
+  size_t off = 0;
+  for (int i = 0; i < n; i++)
+  {
+    memcpy(newbuf + off, iov[i].iov_base, iov[i].iov_len);
+    off += iov[i].iov_len;
+  }
+
+  free(buf);
+  buf = newbuf;
+  cap = newcap;
+  head = 0;
+}
+
+char *TERingBuffer::reserve(size_t len)
+{
+  if (used == 0)
+    head = 0;
+
+  size_t tail = (head + used) & (cap - 1);
+  size_t room;
+  if (used == cap)
+    room = 0;
+  else if (tail >= head)
+    room = cap - tail;
+  else
+    room = head - tail;
+
+  if (room >= len)
+    return buf + tail;
+
+  // Not enough contiguous room behind the tail: move the data to the
+  // start of a (possibly larger) block, which leaves the free space in
+  // one piece.
+  grow(used + len);
+  return buf + used;
+}
+
+void TERingBuffer::commit(size_t len)
+{
+  used += len;
+}
+
+void TERingBuffer::append(const char *data, size_t len)
+{
+  if (used + len > cap)
+    grow(used + len);
+
+  size_t tail = (head + used) & (cap - 1);
+  size_t first = cap - tail;
+  if (first > len)
+    first = len;
+
+  memcpy(buf + tail, data, first);
+  memcpy(buf, data + first, len - first);
+  used += len;
+}
+
+int TERingBuffer::spans(struct iovec *iov) const
+{
+  if (used == 0)
+    return 0;
+
+  size_t first = cap - head;
+  if (first >= used)
+  {
+    iov[0].iov_base = buf + head;
+    iov[0].iov_len = used;
+    return 1;
+  }
+
+  iov[0].iov_base = buf + head;
+  iov[0].iov_len = first;
+  iov[1].iov_base = buf;
+  iov[1].iov_len = used - first;
+  return 2;
+}
+
+const char *TERingBuffer::peek(size_t *len) const
+{
+  size_t first = cap - head;
+  *len = first < used ? first : used;
+  return buf + head;
+}
+
+const char *TERingBuffer::linearize()
+{
+  if (head + used <= cap)
+    return buf + head;
+
+  // The data wraps. Rotate it into place through a scratch block; this
+  // only happens when a consumer did not drain the buffer completely.
+  char *tmp = (char*)malloc(cap);
+  size_t first = cap - head;
+  memcpy(tmp, buf + head, first);
+  memcpy(tmp + first, buf, used - first);
+  free(buf);
+  buf = tmp;
+  head = 0;
+  return buf;
+}
+
+void TERingBuffer::consume(size_t len)
+{
+  if (len >= used)
+  {
+    head = 0;
+    used = 0;
+    return;
+  }
+  head = (head + len) & (cap - 1);
+  used -= len;
+}
@@ -0,0 +1,83 @@
+/*
+    This file is part of Konsole, an X terminal.
+    Copyright (C) 2007 Diego Pettenò <flameeyes@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+#ifndef TERINGBUFFER_H
+#define TERINGBUFFER_H
+
+#include <sys/types.h>
+#include <sys/uio.h>
+
+/*!
+    A growable byte ring used by the serial line for buffering.
+
+    Data is appended at the tail and consumed from the head. The buffer
+    never shrinks, so after the first few wakeups no further allocation
+    takes place on the I/O path.
+*/
+class TERingBuffer
+{
+public:
+    TERingBuffer(size_t initialSize = 4096);
+    ~TERingBuffer();
+
+    /*! number of bytes currently stored */
+    size_t size() const { return used; }
+    /*! number of bytes that can be stored without growing */
+    size_t capacity() const { return cap; }
+    bool isEmpty() const { return used == 0; }
+
+    /*!
+        returns a pointer to at least \a len contiguous writable bytes
+        behind the tail, growing or compacting the buffer if needed.
+        The data becomes part of the buffer only after commit().
+    */
+    char *reserve(size_t len);
+    /*! makes \a len bytes written after reserve() part of the buffer */
+    void commit(size_t len);
+
+    /*! copies \a len bytes to the tail, wrapping around as needed */
+    void append(const char *data, size_t len);
+
+    /*!
+        fills \a iov with up to two spans describing the stored data
+        in order and returns the number of spans used.
+    */
+    int spans(struct iovec *iov) const;
+
+    /*! returns the first contiguous span of data and its length */
+    const char *peek(size_t *len) const;
+
+    /*! makes the stored data contiguous and returns a pointer to it */
+    const char *linearize();
+
+    /*! drops \a len bytes from the head */
+    void consume(size_t len);
+    void clear() { head = 0; used = 0; }
+
+private:
+    void grow(size_t needed);
+
+    char *buf;
+    size_t cap;
+    size_t head;
+    size_t used;
+};
+
+#endif // TERINGBUFFER_H
@@ -69,6 +69,7 @@ TEScreen::TEScreen(int l, int c)
   : lines(l),
     columns(c),
     image(new ca[(lines+1)*columns]),
+    image_lines(0),
     histCursor(0),
     hist(new HistoryScrollNone()),
     cuX(0), cuY(0),
@@ -78,10 +79,20 @@ TEScreen::TEScreen(int l, int c)
     sel_begin(0), sel_TL(0), sel_BR(0),
     sel_busy(false),
     columnmode(false),
-    ef_fg(cacol()), ef_bg(cacol()), ef_re(0),
+    ef_fg(cacol()), ef_bg(cacol()), ef_re(0), ef_style(0),
     sa_cuX(0), sa_cuY(0),
     sa_cu_re(0), sa_cu_fg(cacol()), sa_cu_bg(cacol()),
-    lastPos(-1)
+    lastPos(-1),
+    cooked(new ca[lines*columns+1]),
+    all_dirty(true),
+    gen_count(0),
+    hist_shifts(0),
+    scroll_top(0), scroll_bottom(0), scroll_count(0),
+    ck_histCursor(0), ck_histLines(0), ck_histShifts(0),
+    ck_screen(false),
+    ck_cursor(-1), ck_selTL(-1), ck_selBR(-1),
+    ck_columnmode(false),
+    ck_scrollTop(0), ck_scrollBottom(0), ck_scrollCount(0)
 {
   /*
     this->lines   = lines;
@@ -96,7 +107,12 @@ TEScreen::TEScreen(int l, int c)
 
     histCursor = 0;
   */
+  makeLines();
   line_wrapped.resize(lines+1);
+  dirty_lines.resize(lines+1);
+  view_dirty.resize(lines+1);
+  cooked_dirty.resize(lines+1);
+  markAllDirty();
   initTabStops();
   clearSelection();
   reset();
@@ -108,6 +124,8 @@ TEScreen::TEScreen(int l, int c)
 TEScreen::~TEScreen()
 {
   delete[] image;
+  delete[] image_lines;
+  delete[] cooked;
   delete[] tabstops;
   delete hist;
 }
@@ -282,7 +300,8 @@ void TEScreen::deleteChars(int n)
   if (n == 0) n = 1; // Default
   if (n > columns) n = columns - 1;
   int p = QMAX(0,QMIN(cuX+n,columns-1));
-  moveImage(loc(cuX,cuY),loc(p,cuY),loc(columns-1,cuY));
+  // the cursor may wait past the last column to wrap
+  moveImage(loc(QMIN(cuX,columns-1),cuY),loc(p,cuY),loc(columns-1,cuY));
   clearImage(loc(columns-n,cuY),loc(columns-1,cuY),' ');
 }
 
@@ -428,12 +447,7 @@ void TEScreen::resizeImage(int new_lines, int new_columns)
   // clear new image
   for (int y = 0; y < new_lines; y++) {
     for (int x = 0; x < new_columns; x++)
-    {
-      newimg[y*new_columns+x].c = ' ';
-      newimg[y*new_columns+x].f = cacol(CO_DFT,DEFAULT_FORE_COLOR);
-      newimg[y*new_columns+x].b = cacol(CO_DFT,DEFAULT_BACK_COLOR);
-      newimg[y*new_columns+x].r = DEFAULT_RENDITION;
-    }
+      newimg[y*new_columns+x] = ca();
     newwrapped[y]=false;
   }
   int cpy_lines   = QMIN(new_lines,  lines);
@@ -441,12 +455,7 @@ void TEScreen::resizeImage(int new_lines, int new_columns)
   // copy to new image
   for (int y = 0; y < cpy_lines; y++) {
     for (int x = 0; x < cpy_columns; x++)
-    {
-      newimg[y*new_columns+x].c = image[loc(x,y)].c;
-      newimg[y*new_columns+x].f = image[loc(x,y)].f;
-      newimg[y*new_columns+x].b = image[loc(x,y)].b;
-      newimg[y*new_columns+x].r = image[loc(x,y)].r;
-    }
+      newimg[y*new_columns+x] = image_lines[y][x];
     newwrapped[y]=line_wrapped[y];
   }
   delete[] image;
@@ -454,8 +463,16 @@ void TEScreen::resizeImage(int new_lines, int new_columns)
   line_wrapped = newwrapped;
   lines = new_lines;
   columns = new_columns;
+  makeLines();
+  delete[] cooked;
+  cooked = new ca[lines*columns+1];
+  dirty_lines.resize(lines+1);
+  view_dirty.resize(lines+1);
+  cooked_dirty.resize(lines+1);
+  markAllDirty();
   cuX = QMIN(cuX,columns-1);
   cuY = QMIN(cuY,lines-1);
+  lastPos = -1; // in the old image
 
   // FIXME: try to keep values, evtl.
   tmargin=0;
@@ -499,8 +516,8 @@ void TEScreen::resizeImage(int new_lines, int new_columns)
 */
 
 void TEScreen::reverseRendition(ca* p)
-{ cacol f = p->f; cacol b = p->b;
-  p->f = b; p->b = f; //p->r &= ~RE_TRANSPARENT;
+{
+  p->s = castyle::reversed(p->s);
 }
 
 void TEScreen::effectiveRendition()
@@ -519,84 +536,230 @@ void TEScreen::effectiveRendition()
   }
   if (cu_re & RE_BOLD)
     ef_fg.toggleIntensive();
+  ef_style = castyle::intern(ef_fg, ef_bg, ef_re);
 }
 
 /*!
-    returns the image.
+    Marks the whole view as changed, for when it does not show the
+    same lines as before.
+*/
 
-    Get the size of the image by \sa getLines and \sa getColumns.
+void TEScreen::markAllDirty()
+{
+  all_dirty = true;
+  scroll_count = 0;
+  gen_count++;
+}
+
+/*! marks the lines \a from to \a to of the view as changed. */
 
-    NOTE that the image returned by this function must later be
-    freed.
+void TEScreen::markView(int from, int to)
+{
+  from = QMAX(from, 0);
+  to = QMIN(to, lines-1);
+  for (int y = from; y <= to; y++)
+    view_dirty[y] = 1;
+  gen_count++;
+}
 
+/*!
+    The lines \a top to \a bottom of the screen were scrolled up by \a n
+    lines (down if negative). While the view shows the screen, this is
+    kept as a scroll of the view, so that what was drawn before can be
+    moved instead of drawn again, and only the lines uncovered are dirty.
+    A single region is kept between two cooks; any other scroll just
+    dirties its lines.
 */
 
-ca* TEScreen::getCookedImage()
+void TEScreen::scrollView(int top, int bottom, int n)
 {
-/*kdDebug() << "sel_begin=" << sel_begin << "(" << sel_begin/columns << "," << sel_begin%columns << ")"
-  << "  sel_TL=" << sel_TL << "(" << sel_TL/columns << "," << sel_TL%columns << ")"
-  << "  sel_BR=" << sel_BR << "(" << sel_BR/columns << "," << sel_BR%columns << ")"
-  << "  histcursor=" << histCursor << endl;*/
+  int height = bottom-top+1;
+  if (all_dirty || hist->getLines() != histCursor ||
+      (scroll_count && (top != scroll_top || bottom != scroll_bottom)) ||
+      QABS(scroll_count+n) >= height)
+  {
+    if (scroll_count && top == scroll_top && bottom == scroll_bottom)
+      scroll_count = 0;
+    markDirty(top, bottom);
+    return;
+  }
 
-  int x,y;
-  ca* merged = (ca*)malloc((lines*columns+1)*sizeof(ca));
-  ca dft(' ',cacol(CO_DFT,DEFAULT_FORE_COLOR),cacol(CO_DFT,DEFAULT_BACK_COLOR),DEFAULT_RENDITION);
-  merged[lines*columns] = dft;
+  // the marks move along with the lines
+  int moved = height-QABS(n);
+  int to = n > 0 ? top : top-n;
+  memmove(&dirty_lines[to], &dirty_lines[to+n], moved);
+  memmove(&view_dirty[to], &view_dirty[to+n], moved);
+  if (n > 0)
+    markDirty(bottom-n+1, bottom);
+  else
+    markDirty(top, top-n-1);
 
-//  kdDebug(1211) << "InGetCookedImage" << endl;
-  for (y = 0; (y < lines) && (y < (hist->getLines()-histCursor)); y++)
+  // so does what the cursor and the selection left on the old lines
+  if (ck_cursor != -1)
   {
-    int len = QMIN(columns,hist->getLineLen(y+histCursor));
-    int yp  = y*columns;
+    int y = ck_cursor/columns;
+    if (y >= top && y <= bottom)
+      y -= n;
+    markView(y, y);
+    ck_cursor = -1;
+  }
+  if (ck_selTL != -1 || ck_selBR != -1)
+  {
+    int a = (ck_selTL+columns)/columns-1;
+    int b = (ck_selBR+columns)/columns-1;
+    markView(a, b);
+    markView(a-n, b-n);
+    ck_selTL = ck_selBR = -1;
+  }
 
-//    kdDebug(1211) << "InGetCookedImage - In first For.  Y =" << y << "histCursor = " << histCursor << endl;
-    hist->getCells(y+histCursor,0,len,merged+yp);
-    for (x = len; x < columns; x++) merged[yp+x] = dft;
-    if (sel_begin !=-1)
-    for (x = 0; x < columns; x++)
-      {
+  scroll_top = top;
+  scroll_bottom = bottom;
+  scroll_count += n;
+}
+
+/*!
+    Compares what the view is made of, besides the image, with what it
+    was made of when last cooked: the history position, the inverse
+    display, the cursor and the selection. Lines that show differently
+    because of them are marked.
+*/
+
+void TEScreen::checkView()
+{
+  int histLines = hist->getLines();
+  int offset = histLines-histCursor;
+  bool screen = getMode(MODE_Screen);
+  if (offset != ck_histLines-ck_histCursor ||
+      (offset > 0 && (histCursor != ck_histCursor || hist_shifts != ck_histShifts)) ||
+      screen != ck_screen)
+  {
+    markAllDirty();
+    ck_histCursor = histCursor;
+    ck_histLines = histLines;
+    ck_histShifts = hist_shifts;
+    ck_screen = screen;
+  }
+
+  int cursor = loc(cuX, cuY+offset);
+  if (!getMode(MODE_Cursor) || cursor >= columns*lines)
+    cursor = -1;
+  if (cursor != ck_cursor)
+  {
+    if (ck_cursor != -1)
+      markView(ck_cursor/columns, ck_cursor/columns);
+    if (cursor != -1)
+      markView(cursor/columns, cursor/columns);
+    ck_cursor = cursor;
+  }
+
+  int selTL = -1, selBR = -1;
+  if (sel_begin != -1)
+  {
+    selTL = sel_TL - loc(0,histCursor);
+    selBR = sel_BR - loc(0,histCursor);
+  }
+  if (selTL != ck_selTL || selBR != ck_selBR ||
+      (selTL != -1 && columnmode != ck_columnmode))
+  {
+    // the rows of locations before the view are negative
+    if (ck_selTL != -1 || ck_selBR != -1)
+      markView((ck_selTL+columns)/columns-1, (ck_selBR+columns)/columns-1);
+    if (selTL != -1 || selBR != -1)
+      markView((selTL+columns)/columns-1, (selBR+columns)/columns-1);
+    ck_selTL = selTL;
+    ck_selBR = selBR;
+    ck_columnmode = columnmode;
+  }
+}
+
+/*! cooks line \a y of the view, see getCookedImage(). */
+
+void TEScreen::cookLine(int y)
+{
+  ca dft;
+  ca* merged = cooked + y*columns;
+  int offset = hist->getLines()-histCursor;
+  int x;
+
+  if (y < offset)
+  {
+    int len = QMIN(columns,hist->getLineLen(y+histCursor));
+    hist->getCells(y+histCursor,0,len,merged);
+    for (x = len; x < columns; x++) merged[x] = dft;
 #ifdef REVERSE_WRAPPED_LINES
-        if (hist->isWrappedLine(y+histCursor))
-          reverseRendition(&merged[p]);
+    if (hist->isWrappedLine(y+histCursor))
+      for (x = 0; x < columns; x++)
+        reverseRendition(&merged[x]);
 #endif
-        if (testIsSelected(x,y)) {
-          int p=x + yp;
-          reverseRendition(&merged[p]); // for selection
-    }
   }
-  }
-  if (lines >= hist->getLines()-histCursor)
+  else
   {
-    for (y = (hist->getLines()-histCursor); y < lines ; y++)
-    {
-       int yp  = y*columns;
-       int yr =  (y-hist->getLines()+histCursor)*columns;
-//       kdDebug(1211) << "InGetCookedImage - In second For.  Y =" << y << endl;
-       for (x = 0; x < columns; x++)
-       { int p = x + yp; int r = x + yr;
-         merged[p] = image[r];
+    memcpy(merged, image_lines[y-offset], columns*sizeof(ca));
 #ifdef REVERSE_WRAPPED_LINES
-         if (line_wrapped[y- hist->getLines() +histCursor])
-           reverseRendition(&merged[p]);
+    if (line_wrapped[y-offset])
+      for (x = 0; x < columns; x++)
+        reverseRendition(&merged[x]);
 #endif
-         if (sel_begin != -1 && testIsSelected(x,y))
-           reverseRendition(&merged[p]); // for selection
-       }
-
-    }
   }
+
+  if (sel_begin != -1)
+    for (x = 0; x < columns; x++)
+      if (testIsSelected(x,y))
+        reverseRendition(&merged[x]); // for selection
+
   // evtl. inverse display
   if (getMode(MODE_Screen))
+    for (x = 0; x < columns; x++)
+      reverseRendition(&merged[x]);
+
+  if (ck_cursor != -1 && ck_cursor/columns == y)
+    cooked[ck_cursor].s = castyle::rendered(cooked[ck_cursor].s, RE_CURSOR);
+}
+
+/*!
+    returns the image.
+
+    Get the size of the image by \sa getLines and \sa getColumns.
+
+    The image is kept by the screen and valid until it is next called.
+    Only the lines that changed since are cooked again, they are told
+    by getCookedDirty().
+*/
+
+const ca* TEScreen::getCookedImage()
+{
+  checkView();
+
+  int offset = hist->getLines()-histCursor;
+  ck_scrollCount = 0;
+  if (scroll_count && !all_dirty && offset == 0)
   {
-    for (int i = 0; i < lines*columns; i++)
-      reverseRendition(&merged[i]); // for reverse display
+    // what was cooked moves along, the lines uncovered are dirty
+    int n = scroll_count;
+    int moved = scroll_bottom-scroll_top+1-QABS(n);
+    int to = n > 0 ? scroll_top : scroll_top-n;
+    memmove(&cooked[to*columns], &cooked[(to+n)*columns], moved*columns*sizeof(ca));
+    ck_scrollTop = scroll_top;
+    ck_scrollBottom = scroll_bottom;
+    ck_scrollCount = n;
   }
-//  if (getMode(MODE_Cursor) && (cuY+(hist->getLines()-histCursor) < lines)) // cursor visible
+  else if (scroll_count)
+    all_dirty = true; // the view was moved off the screen meanwhile
+  scroll_count = 0;
 
-  int loc_ = loc(cuX, cuY+hist->getLines()-histCursor);
-  if(getMode(MODE_Cursor) && loc_ < columns*lines)
-    merged[loc(cuX,cuY+(hist->getLines()-histCursor))].r|=RE_CURSOR;
-  return merged;
+  for (int y = 0; y < lines; y++)
+  {
+    cooked_dirty[y] = all_dirty || view_dirty[y] ||
+                      (y >= offset && y-offset < lines && dirty_lines[y-offset]);
+    if (cooked_dirty[y])
+      cookLine(y);
+  }
+  cooked[lines*columns] = ca();
+
+  dirty_lines.fill(0);
+  view_dirty.fill(0);
+  all_dirty = false;
+  return cooked;
 }
 
 QBitArray TEScreen::getCookedLineWrapped()
@@ -649,7 +812,11 @@ void TEScreen::clear()
 void TEScreen::BackSpace()
 {
   cuX = QMAX(0,cuX-1);
-  if (BS_CLEARS) image[loc(cuX,cuY)].c = ' ';
+  if (BS_CLEARS)
+  {
+    image_lines[cuY][cuX].c = ' ';
+    markDirty(cuY, cuY);
+  }
 }
 
 /*!
@@ -754,11 +921,11 @@ void TEScreen::ShowCharacter(unsigned short c)
   int i = loc(cuX,cuY);
 
   checkSelection(i, i); // check if selection is still valid.
+  markDirty(cuY, cuY);
 
-  image[i].c = c;
-  image[i].f = ef_fg;
-  image[i].b = ef_bg;
-  image[i].r = ef_re;
+  ca *p = image_lines[cuY] + cuX;
+  p->c = c;
+  p->s = ef_style;
   
   lastPos = i;
 
@@ -766,24 +933,95 @@ void TEScreen::ShowCharacter(unsigned short c)
 
   while(w)
   {
-     i++;
-     image[i].c = 0;
-     image[i].f = ef_fg;
-     image[i].b = ef_bg;
-     image[i].r = ef_re;
+     p++;
+     p->c = 0;
+     p->s = ef_style;
      w--;
   }
 }
 
+static inline bool isNarrow(unsigned short c)
+{
+  return (c >= 0x20 && c < 0x7f) || konsole_wcwidth(c) == 1;
+}
+
+/*!
+    Shows \a len characters like ShowCharacter(), which are already
+    decoded and translated through the character set.
+
+    Runs of characters one column wide are written a row segment at a
+    time: wrapping, the selection and lastPos are dealt with once per
+    segment rather than once per character. Everything else, and the
+    insert mode, go through ShowCharacter().
+*/
+
+void TEScreen::ShowCharacters(const unsigned short *s, int len)
+{
+  if (getMode(MODE_Insert))
+  {
+    for (int k = 0; k < len; k++)
+      ShowCharacter(s[k]);
+    return;
+  }
+
+  ca cell;
+  cell.s = ef_style;
+  int k = 0;
+  while (k < len)
+  {
+    if (!isNarrow(s[k]))
+    {
+      ShowCharacter(s[k++]);
+      continue;
+    }
+
+    // Wrapping happens before putting the character, see ShowCharacter().
+    if (cuX >= columns)
+    {
+      if (getMode(MODE_Wrap))
+      {
+        line_wrapped[cuY] = true;
+        NextLine();
+      }
+      else
+        cuX = columns-1;
+    }
+
+    int i = loc(cuX,cuY);
+    int n = QMIN(len-k, columns-cuX);
+    markDirty(cuY, cuY);
+    ca *p = image_lines[cuY] + cuX;
+    int j = 0;
+    do
+    {
+      cell.c = s[k+j];
+      p[j++] = cell;
+    }
+    while (j < n && isNarrow(s[k+j]));
+
+    if (sel_begin != -1)
+    {
+      // The same as checkSelection() on each of the cells.
+      int scr_TL = loc(0, hist->getLines());
+      if (QMAX(i, sel_TL-scr_TL+1) <= QMIN(i+j-1, sel_BR-scr_TL-1))
+        clearSelection();
+    }
+    lastPos = i+j-1;
+    cuX += j;
+    k += j;
+  }
+}
+
 void TEScreen::compose(QString compose)
 {
   if (lastPos == -1)
      return;
      
-  QChar c(image[lastPos].c);
+  QChar c(cellAt(lastPos).c);
   compose.prepend(c);
   compose.compose();
-  image[lastPos].c = compose[0].unicode();
+  cellAt(lastPos).c = compose[0].unicode();
+  markDirty(lastPos/columns, lastPos/columns);
 }
 
 // Region commands -------------------------------------------------------------
@@ -915,18 +1153,21 @@ void TEScreen::clearImage(int loca, int loce, char c)
     clearSelection();
   }
   
-  for (i = loca; i <= loce; i++)
+  // Use the current colors but the default rendition
+  // Check with: echo -e '\033[41;33;07m\033[2Khello world\033[00m'
+  ca blank(c, cu_fg, cu_bg, DEFAULT_RENDITION);
+  for (int y = loca/columns; y <= loce/columns; y++)
   {
-    // Use the current colors but the default rendition
-    // Check with: echo -e '\033[41;33;07m\033[2Khello world\033[00m'
-    image[i].c = c;
-    image[i].f = cu_fg;
-    image[i].b = cu_bg;
-    image[i].r = DEFAULT_RENDITION;
+    ca *p = image_lines[y];
+    int x = (y == loca/columns) ? loca%columns : 0;
+    int e = (y == loce/columns) ? loce%columns : columns-1;
+    for (; x <= e; x++)
+      p[x] = blank;
   }
 
   for (i = loca/columns; i<=loce/columns; i++)
     line_wrapped[i]=false;
+  markDirty(loca/columns, loce/columns);
 }
 
 /*! move image between (including) `loca' and `loce' to 'dst'.
@@ -934,6 +1175,10 @@ void TEScreen::clearImage(int loca, int loce, char c)
     This is an internal helper functions. The parameter types are internal
     addresses of within the screen image and make use of the way how the
     screen matrix is mapped to the image vector.
+
+    Either the move is within a single line, or whole lines are moved.
+    In the latter case the lines that are moved over take the place of
+    the lines moved away, rather than keeping what they showed before.
 */
 
 void TEScreen::moveImage(int dst, int loca, int loce)
@@ -943,10 +1188,24 @@ void TEScreen::moveImage(int dst, int loca, int loce)
     kdDebug(1211) << "WARNING!!! call to TEScreen:moveImage with loce < loca!" << endl;
     return;
   }
-  //kdDebug(1211) << "Using memmove to scroll up" << endl;
-  memmove(&image[dst],&image[loca],(loce-loca+1)*sizeof(ca));
-  for (int i=0;i<=(loce-loca+1)/columns;i++)
-    line_wrapped[(dst/columns)+i]=line_wrapped[(loca/columns)+i];
+  if (loca/columns == loce/columns && dst/columns == loca/columns)
+  {
+    memmove(&image_lines[loca/columns][dst%columns],
+            &image_lines[loca/columns][loca%columns],(loce-loca+1)*sizeof(ca));
+    markDirty(loca/columns, loca/columns);
+  }
+  else
+  {
+    // Whole lines are moved by rotating them with the lines they
+    // replace, which end up where they came from.
+    int top = QMIN(loca,dst)/columns;
+    int bottom = (QMAX(loce,dst+loce-loca))/columns;
+    rotateLines(top, bottom, (loca-dst)/columns);
+    if (loca%columns == 0 && dst%columns == 0 && (loce+1)%columns == 0)
+      scrollView(top, bottom, (loca-dst)/columns);
+    else
+      markDirty(top, bottom);
+  }
   if (lastPos != -1)
   {
      int diff = dst - loca; // Scroll by this amount
@@ -992,6 +1251,50 @@ void TEScreen::moveImage(int dst, int loca, int loce)
   }
 }
 
+/*!
+    Rotates the lines \a top to \a bottom (including) up by \a n lines,
+    down if \a n is negative, together with their wrapped flags. Only
+    the line pointers move, the cells stay where they are.
+*/
+
+void TEScreen::rotateLines(int top, int bottom, int n)
+{
+  int len = bottom-top+1;
+  n %= len;
+  if (n < 0) n += len;
+  if (n == 0) return;
+  // rotating is reversing both parts, then the whole
+  reverseLines(top, top+n-1);
+  reverseLines(top+n, bottom);
+  reverseLines(top, bottom);
+}
+
+void TEScreen::reverseLines(int top, int bottom)
+{
+  for (; top < bottom; top++, bottom--)
+  {
+    ca *p = image_lines[top];
+    image_lines[top] = image_lines[bottom];
+    image_lines[bottom] = p;
+    bool w = line_wrapped[top];
+    line_wrapped[top] = line_wrapped[bottom];
+    line_wrapped[bottom] = w;
+  }
+}
+
+/*!
+    points the lines at image, in order. Like image, there is one line
+    more than the screen has, which no line is ever moved to or from.
+*/
+
+void TEScreen::makeLines()
+{
+  delete[] image_lines;
+  image_lines = new ca*[lines+1];
+  for (int y = 0; y <= lines; y++)
+    image_lines[y] = image + y*columns;
+}
+
 /*! clear from (including) current cursor position to end of screen.
 */
 
@@ -1293,7 +1596,7 @@ void TEScreen::getSelText(bool preserve_line_breaks, QTextStream *stream)
       }
       else {				// or from screen image.
         if (testIsSelected((s - hist_BR) % columns, (s - hist_BR) / columns)) {
-          Q_UINT16 c = image[s++ - hist_BR].c;
+          Q_UINT16 c = cellAt(s++ - hist_BR).c;
           if (c) {
             m[d++] = c;
             newlineneeded = true;
@@ -1383,7 +1686,7 @@ void TEScreen::getSelText(bool preserve_line_breaks, QTextStream *stream)
         if (eol < sel_BR)
         {
             while ((eol > s) &&
-                   (!image[eol - hist_BR].c || isSpace(image[eol - hist_BR].c)) &&
+                   (!cellAt(eol - hist_BR).c || isSpace(cellAt(eol - hist_BR).c)) &&
                    !line_wrapped[(eol-hist_BR)/columns])
             {
                 eol--;
@@ -1401,7 +1704,7 @@ void TEScreen::getSelText(bool preserve_line_breaks, QTextStream *stream)
 
         while (s <= eol)
         {
-            Q_UINT16 c = image[s++ - hist_BR].c;
+            Q_UINT16 c = cellAt(s++ - hist_BR).c;
             if (c)
                  m[d++] = c;
         }
@@ -1474,18 +1777,22 @@ void TEScreen::addHistLine()
   { ca dft;
 
     int end = columns-1;
-    while (end >= 0 && image[end] == dft && !line_wrapped[0])
+    while (end >= 0 && image_lines[0][end] == dft && !line_wrapped[0])
       end -= 1;
 
     int oldHistLines = hist->getLines();
 
-    hist->addCells(image,end+1);
+    hist->addCells(image_lines[0],end+1);
     hist->addLine(line_wrapped[0]);
 
     int newHistLines = hist->getLines();
 
     bool beginIsTL = (sel_begin == sel_TL);
 
+    // a full history dropped its oldest line, all of it moved
+    if (newHistLines == oldHistLines)
+       hist_shifts++;
+
     // adjust history cursor
     if (newHistLines > oldHistLines)
     {
@@ -1557,6 +1864,7 @@ void TEScreen::setScroll(const HistoryType& t)
   clearSelection();
   hist = t.getScroll(hist);
   histCursor = hist->getLines();
+  markAllDirty();
 }
 
 bool TEScreen::hasScroll()
@@ -21,6 +21,8 @@
 #ifndef TESCREEN_H
 #define TESCREEN_H
 
+#include <qmemarray.h>
+
 #include "TECommon.h"
 #include "TEHistory.h"
 
@@ -137,6 +139,8 @@ public: // these are all `Screen' operations
     void reset();
     // Show character
     void ShowCharacter(unsigned short c);
+    // Show a run of characters, as many calls to ShowCharacter would
+    void ShowCharacters(const unsigned short *s, int len);
     
     // Do composition with last shown character
     void compose(QString compose);
@@ -144,8 +148,16 @@ public: // these are all `Screen' operations
     //
     void resizeImage(int new_lines, int new_columns);
     //
-    ca*  getCookedImage();
+    const ca* getCookedImage();
+    /*! lines of the view the last getCookedImage() changed, [lines] */
+    const char* getCookedDirty() { return cooked_dirty.data(); }
+    /*! lines the last getCookedImage() scrolled the view lines \a top to
+        \a bottom up by (down if negative) before it changed the dirty ones */
+    int getCookedScroll(int &top, int &bottom)
+    { top = ck_scrollTop; bottom = ck_scrollBottom; return ck_scrollCount; }
     QBitArray getCookedLineWrapped();
+    /*! changes whenever getCookedImage() would return something new. */
+    unsigned long generation() { checkView(); return gen_count; }
 
     /*! return the number of lines. */
     int  getLines()   { return lines; }
@@ -182,6 +194,12 @@ private: // helper
 
     void clearImage(int loca, int loce, char c);
     void moveImage(int dst, int loca, int loce);
+    void rotateLines(int top, int bottom, int n);
+    void reverseLines(int top, int bottom);
+    void makeLines();
+
+    /*! the cell at location \a i of the screen */
+    ca &cellAt(int i) { return image_lines[i/columns][i%columns]; }
     
     void scrollUp(int from, int i);
     void scrollDown(int from, int i);
@@ -190,6 +208,14 @@ private: // helper
 
     void initTabStops();
 
+    void markDirty(int from, int to)
+    { for (int y = from; y <= to; y++) dirty_lines[y] = 1; gen_count++; }
+    void markAllDirty();
+    void markView(int from, int to);
+    void scrollView(int top, int bottom, int n);
+    void checkView();
+    void cookLine(int y);
+
     void effectiveRendition();
     void reverseRendition(ca* p);
 
@@ -207,7 +233,8 @@ private: // helper
 
     int lines;
     int columns;
-    ca *image; // [lines][columns]
+    ca *image; // [lines][columns], the lines in any order
+    ca **image_lines; // [lines+1] the lines of image from top to bottom
     QBitArray line_wrapped; // [lines]
 
     // history buffer ---------------
@@ -252,6 +279,7 @@ private: // helper
     cacol ef_fg;      // These are derived from
     cacol ef_bg;      // the cu_* variables above
     UINT8 ef_re;      // to speed up operation
+    UINT16 ef_style;  // and the style of all three
 
     //
     // save cursor, rendition & states ------------
@@ -271,6 +299,32 @@ private: // helper
     // last position where we added a character
     int lastPos;
 
+    // damage tracking --------------
+
+    ca *cooked;                   // [lines][columns] the last cooked image
+    QMemArray<char> dirty_lines;  // [lines] image lines changed since
+    QMemArray<char> view_dirty;   // [lines] view lines changed since
+    QMemArray<char> cooked_dirty; // [lines] view lines last cooked
+    bool all_dirty;
+    unsigned long gen_count;
+    int hist_shifts;              // times a full history lost a line
+    int scroll_top;               // lines scrolled up since, as a whole,
+    int scroll_bottom;            // see scrollView()
+    int scroll_count;
+
+    // what the cooked image was made of, see checkView()
+    int ck_histCursor;
+    int ck_histLines;
+    int ck_histShifts;
+    bool ck_screen;
+    int ck_cursor;    // location of the cursor in the view, -1 if hidden
+    int ck_selTL;     // selection relative to the view, -1 if none
+    int ck_selBR;
+    bool ck_columnmode;
+    int ck_scrollTop;
+    int ck_scrollBottom;
+    int ck_scrollCount;
+
     // modes
 
     ScreenParm saveParm;
@@ -0,0 +1,344 @@
+/*
+    This file is part of Konsole, an X terminal.
+    Copyright (C) 2007 Diego Pettenò <flameeyes@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+
+#include <qfile.h>
+#include <qsocketnotifier.h>
+
+#include <klocale.h>
+#include <kdebug.h>
+
+#include "TEShareServer.h"
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+#define DEFAULT_CLIENT_LIMIT 65536
+
+struct TEShareServer::Client
+{
+  int fd;
+  QSocketNotifier *readNotifier;
+  QSocketNotifier *writeNotifier;
+  TERingBuffer out;
+  unsigned long long dropped;
+};
+
+/*
+   Writes to the clients go through sendmsg() rather than write(), so
+   that a client that went away gives EPIPE instead of a SIGPIPE.
+*/
+static int sendSpans(int fd, struct iovec *iov, int count)
+{
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = iov;
+  msg.msg_iovlen = count;
+
+  int r;
+  do
+    r = sendmsg(fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+  while ( r < 0 && errno == EINTR );
+  return r;
+}
+
+TEShareServer::TEShareServer(QObject *parent)
+  : QObject(parent)
+  , m_fd(-1)
+  , m_notifier(0)
+  , m_policy(DropData)
+  , m_limit(DEFAULT_CLIENT_LIMIT)
+  , m_inputSuspended(false)
+  , m_dropped(0)
+{
+}
+
+TEShareServer::~TEShareServer()
+{
+  close();
+}
+
+bool TEShareServer::listen(const QString &path)
+{
+  close();
+
+  QCString name = QFile::encodeName(path);
+  struct sockaddr_un addr;
+  if ( name.length() >= sizeof(addr.sun_path) )
+  {
+    m_strError = i18n("Socket path %1 is too long").arg(path);
+    kdWarning(1211) << "TEShareServer: " << m_strError << endl;
+    return false;
+  }
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, name.data());
+
+  // A socket nobody listens on any more is left over from a session
+  // that died; one that still accepts connections belongs to another.
+  struct stat st;
+  if ( lstat(name.data(), &st) == 0 && S_ISSOCK(st.st_mode) )
+  {
+    int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+    if ( probe >= 0 && ::connect(probe, (struct sockaddr*)&addr, sizeof(addr)) == 0 )
+    {
+      ::close(probe);
+      m_strError = i18n("%1 is in use by another program").arg(path);
+      kdWarning(1211) << "TEShareServer: " << m_strError << endl;
+      return false;
+    }
+    if ( probe >= 0 ) ::close(probe);
+    unlink(name.data());
+  }
+
+  m_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if ( m_fd < 0 || bind(m_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 ||
+       ::listen(m_fd, 8) < 0 )
+  {
+    m_strError = i18n("Cannot listen on %1: %2").arg(path).arg(strerror(errno));
+    kdWarning(1211) << "TEShareServer: " << m_strError << endl;
+    if ( m_fd >= 0 ) ::close(m_fd);
+    m_fd = -1;
+    return false;
+  }
+
+  // The line is as private as the user's terminal.
+  chmod(name.data(), 0600);
+  fcntl(m_fd, F_SETFL, O_NONBLOCK);
+  fcntl(m_fd, F_SETFD, FD_CLOEXEC);
+
+  m_path = path;
+  m_strError = QString::null;
+  m_notifier = new QSocketNotifier(m_fd, QSocketNotifier::Read, this);
+  connect( m_notifier, SIGNAL(activated(int)), this, SLOT(accept()) );
+  return true;
+}
+
+void TEShareServer::close()
+{
+  while ( !m_clients.isEmpty() )
+    drop(m_clients.first());
+
+  if ( m_fd < 0 ) return;
+
+  delete m_notifier;
+  m_notifier = 0;
+  ::close(m_fd);
+  m_fd = -1;
+  unlink(QFile::encodeName(m_path));
+  m_path = QString::null;
+}
+
+void TEShareServer::accept()
+{
+  int fd;
+  while ( (fd = ::accept(m_fd, 0, 0)) >= 0 )
+  {
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+    Client *client = new Client;
+    client->fd = fd;
+    client->dropped = 0;
+    client->readNotifier = new QSocketNotifier(fd, QSocketNotifier::Read, this);
+    connect( client->readNotifier, SIGNAL(activated(int)), this, SLOT(clientReadable(int)) );
+    client->writeNotifier = new QSocketNotifier(fd, QSocketNotifier::Write, this);
+    connect( client->writeNotifier, SIGNAL(activated(int)), this, SLOT(clientWritable(int)) );
+    m_clients.append(client);
+    updateNotifiers(client);
+
+    kdDebug(1211) << "TEShareServer: client " << fd << " connected to " << m_path << endl;
+    emit clientsChanged(m_clients.count());
+  }
+}
+
+TEShareServer::Client *TEShareServer::find(int fd) const
+{
+  QValueList<Client*>::ConstIterator it;
+  for ( it = m_clients.begin(); it != m_clients.end(); ++it )
+    if ( (*it)->fd == fd )
+      return *it;
+  return 0;
+}
+
+void TEShareServer::drop(Client *client)
+{
+  kdDebug(1211) << "TEShareServer: client " << client->fd << " disconnected, "
+                << client->dropped << " bytes dropped" << endl;
+
+  // This may run from the slot of one of the notifiers.
+  client->readNotifier->setEnabled(false);
+  client->writeNotifier->setEnabled(false);
+  client->readNotifier->deleteLater();
+  client->writeNotifier->deleteLater();
+  ::close(client->fd);
+
+  m_clients.remove(client);
+  delete client;
+  emit clientsChanged(m_clients.count());
+}
+
+/*!
+    Writes as much of the backlog of \a client as it takes. Returns
+    false if the client is gone.
+*/
+bool TEShareServer::flush(Client *client)
+{
+  while ( !client->out.isEmpty() )
+  {
+    struct iovec iov[2];
+    int r = sendSpans(client->fd, iov, client->out.spans(iov));
+    if ( r < 0 )
+      return errno == EAGAIN;
+    client->out.consume(r);
+  }
+  return true;
+}
+
+void TEShareServer::updateNotifiers(Client *client)
+{
+  client->writeNotifier->setEnabled(!client->out.isEmpty());
+
+  // A blocked client may not send until it has read most of what it
+  // was sent; that is what its input would usually be waiting for.
+  bool blocked = m_policy == BlockClient && (int)client->out.size() > m_limit / 2;
+  client->readNotifier->setEnabled(!m_inputSuspended && !blocked);
+}
+
+void TEShareServer::send(const char *data, int len)
+{
+  QValueList<Client*> gone;
+
+  QValueList<Client*>::Iterator it;
+  for ( it = m_clients.begin(); it != m_clients.end(); ++it )
+  {
+    Client *client = *it;
+    const char *p = data;
+    int left = len;
+
+    // Nothing queued, try to hand the data over right away.
+    if ( client->out.isEmpty() )
+    {
+      struct iovec iov;
+      iov.iov_base = (void*)p;
+      iov.iov_len = left;
+      int r = sendSpans(client->fd, &iov, 1);
+      if ( r < 0 && errno != EAGAIN )
+      {
+        gone.append(client);
+        continue;
+      }
+      if ( r > 0 )
+      {
+        p += r;
+        left -= r;
+      }
+    }
+    if ( !left )
+      continue;
+
+    int room = m_limit - (int)client->out.size();
+    if ( left > room )
+    {
+      if ( m_policy == BlockClient )
+      {
+        kdDebug(1211) << "TEShareServer: client " << client->fd << " fell "
+                      << m_limit << " bytes behind" << endl;
+        gone.append(client);
+        continue;
+      }
+      client->dropped += left - room;
+      m_dropped += left - room;
+      left = room;
+    }
+    if ( left > 0 )
+      client->out.append(p, left);
+    updateNotifiers(client);
+  }
+
+  for ( it = gone.begin(); it != gone.end(); ++it )
+    drop(*it);
+}
+
+void TEShareServer::clientReadable(int fd)
+{
+  Client *client = find(fd);
+  if ( !client ) return;
+
+  char buf[4096];
+  int r;
+  do
+    r = ::read(fd, buf, sizeof(buf));
+  while ( r < 0 && errno == EINTR );
+
+  if ( r == 0 || (r < 0 && errno != EAGAIN) )
+  {
+    drop(client);
+    return;
+  }
+  if ( r > 0 )
+    emit received(buf, r);
+}
+
+void TEShareServer::clientWritable(int fd)
+{
+  Client *client = find(fd);
+  if ( !client ) return;
+
+  if ( !flush(client) )
+  {
+    drop(client);
+    return;
+  }
+  updateNotifiers(client);
+}
+
+void TEShareServer::suspendInput()
+{
+  if ( m_inputSuspended ) return;
+  m_inputSuspended = true;
+
+  QValueList<Client*>::Iterator it;
+  for ( it = m_clients.begin(); it != m_clients.end(); ++it )
+    updateNotifiers(*it);
+}
+
+void TEShareServer::resumeInput()
+{
+  if ( !m_inputSuspended ) return;
+  m_inputSuspended = false;
+
+  QValueList<Client*>::Iterator it;
+  for ( it = m_clients.begin(); it != m_clients.end(); ++it )
+    updateNotifiers(*it);
+}
+
+#include "TEShareServer.moc"
@@ -0,0 +1,129 @@
+/*
+    This file is part of Konsole, an X terminal.
+    Copyright (C) 2007 Diego Pettenò <flameeyes@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+/*! \file TEShareServer.h
+    \brief Sharing a session with other programs over a local socket.
+*/
+
+#ifndef TESHARESERVER_H
+#define TESHARESERVER_H
+
+#include <qobject.h>
+#include <qstring.h>
+#include <qvaluelist.h>
+
+#include "TERingBuffer.h"
+#include "TETap.h"
+
+class QSocketNotifier;
+
+/*!
+    A UNIX domain socket other programs can connect to, to see what the
+    line receives and to send to it alongside the user.
+
+    Everything received is copied to every client. Clients that do not
+    keep up get a bounded buffer each, so a stalled client never holds
+    up the line or the terminal; what happens when the buffer is full
+    is decided by the Policy. What the clients write is handed on with
+    received(), to go through the transmit queue of the session.
+
+    The server is a raw inline tap of the session it shares.
+*/
+class TEShareServer : public QObject, public TETap
+{
+Q_OBJECT
+
+public:
+    /*! what to do with a client whose buffer is full */
+    enum Policy {
+        DropData,    //!< drop what does not fit, the client misses it
+        BlockClient  //!< stop reading from the client, disconnect it on overflow
+    };
+
+    TEShareServer(QObject *parent = 0);
+    ~TEShareServer();
+
+    /*!
+        starts listening at \a path, replacing a stale socket left
+        there. Returns false and sets error() on failure.
+    */
+    bool listen(const QString &path);
+    /*! disconnects all clients and removes the socket */
+    void close();
+
+    bool isListening() const { return m_fd >= 0; }
+    QString path() const { return m_path; }
+    QString error() const { return m_strError; }
+
+    void setPolicy(Policy policy) { m_policy = policy; }
+    Policy policy() const { return m_policy; }
+
+    /*! bytes buffered at most for each client, 64KiB by default */
+    void setClientLimit(int bytes) { m_limit = bytes; }
+
+    int clients() const { return m_clients.count(); }
+    /*! bytes dropped so far for clients that fell behind */
+    unsigned long long dropped() const { return m_dropped; }
+
+    virtual void rawData(const char *data, int len) { send(data, len); }
+
+public slots:
+    /*! copies \a data to every client */
+    void send(const char *data, int len);
+
+    /*!
+        stops reading from the clients until resumeInput(), for when
+        the transmit queue is full.
+    */
+    void suspendInput();
+    void resumeInput();
+
+signals:
+    /*! data written by a client */
+    void received(const char *data, int len);
+    void clientsChanged(int clients);
+
+private slots:
+    void accept();
+    void clientReadable(int fd);
+    void clientWritable(int fd);
+
+private:
+    struct Client;
+
+    Client *find(int fd) const;
+    void drop(Client *client);
+    bool flush(Client *client);
+    void updateNotifiers(Client *client);
+
+    int m_fd;
+    QSocketNotifier *m_notifier;
+    QString m_path;
+    QString m_strError;
+
+    Policy m_policy;
+    int m_limit;
+    bool m_inputSuspended;
+    unsigned long long m_dropped;
+
+    QValueList<Client*> m_clients;
+};
+
+#endif // TESHARESERVER_H
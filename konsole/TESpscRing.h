@@ -0,0 +1,163 @@
+/*
+    This file is part of Konsole, an X terminal.
+    Copyright (C) 2007 Diego Pettenò <flameeyes@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+/*! \file TESpscRing.h
+    \brief Lock-free byte ring shared between exactly two threads.
+*/
+
+#ifndef TESPSCRING_H
+#define TESPSCRING_H
+
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__GNUC__)
+# define te_memory_barrier() __sync_synchronize()
+# define te_flag_raise(f)    __sync_bool_compare_and_swap((f), 0, 1)
+# define te_flag_take(f)     __sync_bool_compare_and_swap((f), 1, 0)
+# define te_flag_clear(f)    __sync_lock_release((f))
+#else
+# error "TESpscRing needs the GCC atomic builtins"
+#endif
+
+/*!
+    A fixed size single-producer/single-consumer byte ring.
+
+    One thread only ever calls the producer functions, another one only
+    the consumer functions. The two positions are free running counters,
+    each written by one side only, so no lock is needed; the barriers
+    make sure the data is visible before the position that publishes it.
+*/
+class TESpscRing
+{
+public:
+    TESpscRing(size_t capacity);
+    ~TESpscRing() { free(buf); }
+
+    size_t capacity() const { return mask + 1; }
+
+    // producer side
+
+    /*! number of bytes that can be written */
+    size_t writeSpace() const;
+    /*! returns the first contiguous free span and its length */
+    char *writePointer(size_t *len) const;
+    /*! publishes \a len bytes written through writePointer() */
+    void produce(size_t len);
+    /*! copies as much of \a data as fits and returns the amount copied */
+    size_t write(const char *data, size_t len);
+
+    // consumer side
+
+    /*! number of bytes that can be read */
+    size_t readAvailable() const;
+    /*! fills up to two spans with readable data, returns the count */
+    int readSpans(struct iovec *iov) const;
+    /*! releases \a len bytes to the producer */
+    void consume(size_t len);
+
+private:
+    char *buf;
+    size_t mask;
+    volatile size_t wpos; // only written by the producer
+    volatile size_t rpos; // only written by the consumer
+};
+
+inline TESpscRing::TESpscRing(size_t capacity)
+  : mask(0), wpos(0), rpos(0)
+{
+  size_t c = 1;
+  while (c < capacity)
+    c <<= 1;
+  buf = (char*)malloc(c);
+  mask = c - 1;
+}
+
+inline size_t TESpscRing::writeSpace() const
+{
+  return capacity() - (wpos - rpos);
+}
+
+inline char *TESpscRing::writePointer(size_t *len) const
+{
+  size_t w = wpos;
+  size_t space = capacity() - (w - rpos);
+  size_t off = w & mask;
+  size_t first = capacity() - off;
+  *len = first < space ? first : space;
+  return buf + off;
+}
+
+inline void TESpscRing::produce(size_t len)
+{
+  te_memory_barrier(); // data before position
+  wpos = wpos + len;
+}
+
+inline size_t TESpscRing::write(const char *data, size_t len)
+{
+  size_t space = writeSpace();
+  if (len > space)
+    len = space;
+  size_t off = wpos & mask;
+  size_t first = capacity() - off;
+  if (first > len)
+    first = len;
+  memcpy(buf + off, data, first);
+  memcpy(buf, data + first, len - first);
+  produce(len);
+  return len;
+}
+
+inline size_t TESpscRing::readAvailable() const
+{
+  size_t avail = wpos - rpos;
+  te_memory_barrier(); // position before data
+  return avail;
+}
+
+inline int TESpscRing::readSpans(struct iovec *iov) const
+{
+  size_t avail = readAvailable();
+  if (!avail)
+    return 0;
+  size_t off = rpos & mask;
+  size_t first = capacity() - off;
+  iov[0].iov_base = buf + off;
+  if (first >= avail)
+  {
+    iov[0].iov_len = avail;
+    return 1;
+  }
+  iov[0].iov_len = first;
+  iov[1].iov_base = buf;
+  iov[1].iov_len = avail - first;
+  return 2;
+}
+
+inline void TESpscRing::consume(size_t len)
+{
+  te_memory_barrier(); // finish reading before handing the space back
+  rpos = rpos + len;
+}
+
+#endif // TESPSCRING_H
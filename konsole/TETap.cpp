@@ -0,0 +1,248 @@
+/*
+    This file is part of Konsole, an X terminal.
+    Copyright (C) 2007 Diego Pettenò <flameeyes@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+#include <qtextcodec.h>
+
+#ifdef QT_THREAD_SUPPORT
+#include <qthread.h>
+#endif
+
+#include "TETap.h"
+
+// Data held for worker taps at most; beyond that it is dropped.
+#define MAX_STAGED (1024*1024)
+
+#ifdef QT_THREAD_SUPPORT
+/*
+   Swaps the staging buffers and hands the full one to the worker taps,
+   so dispatch() only ever holds the lock for a memcpy.
+*/
+class TETapThread : public QThread
+{
+public:
+  TETapThread(TETapList *list)
+    : m_list(list), m_stop(false), m_decoder(0), m_codec(0) {}
+  ~TETapThread() { delete m_decoder; }
+  void stop();
+
+protected:
+  virtual void run();
+
+private:
+  TETapList *m_list;
+  bool m_stop;                // protected by the list's lock
+  QTextDecoder *m_decoder;
+  const QTextCodec *m_codec;
+};
+
+void TETapThread::stop()
+{
+  m_list->m_lock.lock();
+  m_stop = true;
+  m_list->m_wake.wakeOne();
+  m_list->m_lock.unlock();
+}
+
+void TETapThread::run()
+{
+  TETapList *l = m_list;
+  for (;;)
+  {
+    l->m_lock.lock();
+    while ( l->m_staging->isEmpty() && !l->m_pendingLoss && !m_stop )
+      l->m_wake.wait(&l->m_lock);
+    if ( m_stop )
+    {
+      l->m_lock.unlock();
+      break;
+    }
+    TERingBuffer *full = l->m_staging;
+    l->m_staging = ( full == &l->m_buffers[0] ) ? &l->m_buffers[1] : &l->m_buffers[0];
+    unsigned long long loss = l->m_pendingLoss;
+    l->m_pendingLoss = 0;
+    const QTextCodec *codec = l->m_workerCodec;
+    l->m_lock.unlock();
+
+    if ( codec != m_codec )
+    {
+      delete m_decoder;
+      m_decoder = 0;
+      m_codec = codec;
+    }
+
+    // Everything staged came before the data that was dropped.
+    QMutexLocker locker(&l->m_deliverLock);
+    if ( !full->isEmpty() )
+      l->deliver(l->m_worker, m_decoder, codec, full->linearize(), full->size());
+    full->clear();
+    if ( loss )
+    {
+      QValueList<TETap*>::Iterator it;
+      for ( it = l->m_worker.begin(); it != l->m_worker.end(); ++it )
+        (*it)->dataLost(loss);
+    }
+  }
+}
+#endif
+
+TETapList::TETapList()
+  : m_count(0)
+  , m_decoder(0)
+  , m_codec(0)
+  , m_lostBytes(0)
+{
+#ifdef QT_THREAD_SUPPORT
+  m_workerCodec = 0;
+  m_staging = &m_buffers[0];
+  m_pendingLoss = 0;
+  m_thread = 0;
+#endif
+}
+
+TETapList::~TETapList()
+{
+#ifdef QT_THREAD_SUPPORT
+  stopThread();
+#endif
+  delete m_decoder;
+}
+
+void TETapList::add(TETap *tap)
+{
+  m_count++;
+
+#ifdef QT_THREAD_SUPPORT
+  if ( tap->context() == TETap::Worker )
+  {
+    m_deliverLock.lock();
+    m_worker.append(tap);
+    m_deliverLock.unlock();
+
+    if ( !m_thread )
+    {
+      m_thread = new TETapThread(this);
+      m_thread->start();
+    }
+    return;
+  }
+#endif
+  // Without threads, worker taps are called inline like the others.
+  m_inline.append(tap);
+}
+
+void TETapList::remove(TETap *tap)
+{
+  if ( m_inline.remove(tap) )
+  {
+    m_count--;
+    return;
+  }
+
+#ifdef QT_THREAD_SUPPORT
+  // Waits for the worker to finish a delivery in progress.
+  m_deliverLock.lock();
+  bool found = m_worker.remove(tap);
+  bool last = m_worker.isEmpty();
+  m_deliverLock.unlock();
+
+  if ( found )
+    m_count--;
+  if ( last )
+    stopThread();
+#endif
+}
+
+void TETapList::dispatch(const char *data, int len, const QTextCodec *codec)
+{
+  if ( !m_inline.isEmpty() )
+  {
+    if ( codec != m_codec )
+    {
+      delete m_decoder;
+      m_decoder = 0;
+      m_codec = codec;
+    }
+    // A copy, taps may remove themselves while being called.
+    QValueList<TETap*> taps = m_inline;
+    deliver(taps, m_decoder, codec, data, len);
+  }
+
+#ifdef QT_THREAD_SUPPORT
+  if ( m_thread )
+  {
+    m_lock.lock();
+    if ( m_staging->size() + len > MAX_STAGED )
+    {
+      m_lostBytes += len;
+      m_pendingLoss += len;
+    }
+    else
+      m_staging->append(data, len);
+    m_workerCodec = codec;
+    m_wake.wakeOne();
+    m_lock.unlock();
+  }
+#endif
+}
+
+void TETapList::deliver(QValueList<TETap*> &taps, QTextDecoder *&decoder,
+                        const QTextCodec *codec, const char *data, int len)
+{
+  QString text;
+  bool decoded = false;
+
+  QValueList<TETap*>::Iterator it;
+  for ( it = taps.begin(); it != taps.end(); ++it )
+  {
+    TETap *tap = *it;
+    if ( tap->format() == TETap::Raw )
+    {
+      tap->rawData(data, len);
+      continue;
+    }
+
+    // Decoded once for all text taps; the decoder keeps characters
+    // split across blocks.
+    if ( !decoded )
+    {
+      if ( !decoder && codec )
+        decoder = codec->makeDecoder();
+      text = decoder ? decoder->toUnicode(data, len) : QString::fromLatin1(data, len);
+      decoded = true;
+    }
+    tap->textData(text);
+  }
+}
+
+#ifdef QT_THREAD_SUPPORT
+void TETapList::stopThread()
+{
+  if ( !m_thread ) return;
+
+  m_thread->stop();
+  m_thread->wait();
+  delete m_thread;
+  m_thread = 0;
+
+  m_buffers[0].clear();
+  m_buffers[1].clear();
+  m_pendingLoss = 0;
+}
+#endif
@@ -0,0 +1,127 @@
+/*
+    This file is part of Konsole, an X terminal.
+    Copyright (C) 2007 Diego Pettenò <flameeyes@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+/*! \file TETap.h
+    \brief Subscribers to the data a session receives.
+*/
+
+#ifndef TETAP_H
+#define TETAP_H
+
+#include <qstring.h>
+#include <qvaluelist.h>
+
+#include "TERingBuffer.h"
+
+#ifdef QT_THREAD_SUPPORT
+#include <qmutex.h>
+#include <qwaitcondition.h>
+#endif
+
+class QTextCodec;
+class QTextDecoder;
+class TETapThread;
+
+/*!
+    Something that wants to see the data a session receives, next to
+    the emulation.
+
+    A tap asks for the data either as raw bytes or as text decoded with
+    the encoding of the session, and to be called either right away in
+    the GUI thread or later from a worker thread. Worker taps cost the
+    GUI thread a copy of the data and nothing else; if they fall too
+    far behind, data is dropped for them and dataLost() says how much.
+*/
+class TETap
+{
+public:
+    enum Format { Raw, Text };
+    enum Context { Inline, Worker };
+
+    TETap(Format format = Raw, Context context = Inline)
+      : m_format(format), m_context(context) {}
+    virtual ~TETap() {}
+
+    Format format() const { return m_format; }
+    Context context() const { return m_context; }
+
+    /*! received bytes, for Raw taps */
+    virtual void rawData(const char *, int) {}
+    /*! received text, for Text taps */
+    virtual void textData(const QString &) {}
+    /*! \a bytes were dropped before reaching a Worker tap */
+    virtual void dataLost(unsigned long long /*bytes*/) {}
+
+private:
+    Format m_format;
+    Context m_context;
+};
+
+/*!
+    The taps of a session. With no taps, dispatch() is never called and
+    the received data costs nothing extra; text is only decoded once per
+    block for all taps that want it.
+
+    Taps are not owned. Once remove() returns, a worker tap is not
+    called any more and can be deleted.
+*/
+class TETapList
+{
+public:
+    TETapList();
+    ~TETapList();
+
+    void add(TETap *tap);
+    void remove(TETap *tap);
+    bool isEmpty() const { return m_count == 0; }
+
+    /*! hands \a data to all taps, decoding it with \a codec for text taps */
+    void dispatch(const char *data, int len, const QTextCodec *codec);
+
+    /*! bytes dropped because worker taps did not keep up */
+    unsigned long long lostBytes() const { return m_lostBytes; }
+
+private:
+    friend class TETapThread;
+
+    void deliver(QValueList<TETap*> &taps, QTextDecoder *&decoder,
+                 const QTextCodec *codec, const char *data, int len);
+    void stopThread();
+
+    int m_count;
+    QValueList<TETap*> m_inline;
+    QTextDecoder *m_decoder;          // for inline taps
+    const QTextCodec *m_codec;
+    unsigned long long m_lostBytes;
+
+#ifdef QT_THREAD_SUPPORT
+    QValueList<TETap*> m_worker;      // protected by m_deliverLock
+    const QTextCodec *m_workerCodec;  // protected by m_lock
+    QMutex m_deliverLock;             // held while the worker calls taps
+    QMutex m_lock;                    // protects the staging buffer
+    QWaitCondition m_wake;
+    TERingBuffer m_buffers[2];
+    TERingBuffer *m_staging;
+    unsigned long long m_pendingLoss; // protected by m_lock
+    TETapThread *m_thread;
+#endif
+};
+
+#endif // TETAP_H
@@ -0,0 +1,732 @@
+/*
+    This file is part of Konsole, an X terminal.
+    Copyright (C) 2007 Diego Pettenò <flameeyes@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+/*! \class TETransport
+
+    The part of the line handling that does not depend on what the
+    descriptors are connected to: batching, transmit queue, read
+    coalescing, capture and the optional I/O thread.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <sys/types.h>
+#include <sys/ioctl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <fcntl.h>
+
+#include <qtimer.h>
+
+#include <kdebug.h>
+
+#include "TETransport.h"
+#include "TETty.h"
+#include "TETransports.h"
+#include "TESpscRing.h"
+#include "TEReactor.h"
+#include "TECapture.h"
+
+// Upper bound of data drained from the line in a single read
+// notification, so that a fast line cannot starve the other sessions.
+#define DEFAULT_READ_BATCH_LIMIT (64*1024)
+
+// Transmit queue thresholds for highWatermark() / lowWatermark().
+#define DEFAULT_HIGH_WATERMARK (64*1024)
+#define DEFAULT_LOW_WATERMARK  (16*1024)
+
+// Ring sizes used in threaded mode. The receive ring is what absorbs
+// the line while the GUI thread is busy: 1 MB holds about three
+// seconds of a 3 Mbaud line.
+#define THREAD_RX_RING_SIZE (1024*1024)
+#define THREAD_TX_RING_SIZE (64*1024)
+
+// Read coalescing window used by the throughput latency profile.
+#define THROUGHPUT_COALESCE_MSECS 20
+
+TETransport *TETransport::create(const QString &device)
+{
+  if ( device.startsWith("unix:") )
+    return new TEUnixSocketTransport(device.mid(5));
+  if ( device.startsWith("fifo:") )
+    return new TEFifoTransport(device.mid(5));
+  if ( device.startsWith("pty:") )
+    return new TEPtyTransport();
+  if ( device.startsWith("playback:") )
+    return new TEPlaybackTransport(device.mid(9));
+  return new TETty(device);
+}
+
+/*!
+    Create an instance. The backend opens its descriptors and passes
+    them to setDescriptors().
+*/
+TETransport::TETransport(const QString &name)
+  : m_name(name)
+  , m_readFd(-1)
+  , m_writeFd(-1)
+  , m_rxBuffer(4096)
+  , m_readBatchLimit(DEFAULT_READ_BATCH_LIMIT)
+  , m_readWakeups(0)
+  , m_bytesReceived(0)
+  , m_lastReadBatch(0)
+  , m_writeWakeups(0)
+  , m_latencyProfile(lpInteractive)
+  , m_coalesceMsecs(0)
+  , m_txBuffer(4096)
+  , m_lowWatermark(DEFAULT_LOW_WATERMARK)
+  , m_highWatermark(DEFAULT_HIGH_WATERMARK)
+  , m_capture(0)
+  , m_readNotifier(0)
+  , m_writeNotifier(0)
+  , m_port(0)
+  , m_rxRing(0)
+  , m_txRing(0)
+  , m_rxEventPending(0)
+  , m_txEventPending(0)
+  , m_rxStalled(0)
+  , m_txIdle(0)
+  , m_rxError(0)
+{
+  m_aboveHighWatermark = false;
+  m_readEof = false;
+  memset(&m_stats, 0, sizeof(m_stats));
+
+  m_coalesceTimer = new QTimer(this);
+  connect( m_coalesceTimer, SIGNAL(timeout()), this, SLOT(coalesceTimeout()) );
+}
+
+/*!
+    Destructor. Backends close their descriptors after this ran.
+*/
+TETransport::~TETransport()
+{
+  kdDebug(1211) << "TETransport " << m_name << ": " << m_bytesReceived << " bytes in "
+                << m_readWakeups << " wakeups (" << bytesPerWakeup() << " bytes/wakeup), "
+                << m_writeWakeups << " write wakeups" << endl;
+  releaseDescriptors();
+}
+
+void TETransport::setDescriptors(int readFd, int writeFd)
+{
+  m_readFd = readFd;
+  m_writeFd = writeFd;
+
+  if ( m_readFd >= 0 )
+  {
+    m_readNotifier = new QSocketNotifier( m_readFd, QSocketNotifier::Read, this );
+    connect( m_readNotifier, SIGNAL(activated(int)), this, SLOT(dataReceived()) );
+  }
+  if ( m_writeFd >= 0 )
+  {
+    // A line is writable nearly all the time, so the write notifier is
+    // only enabled while there is something queued.
+    m_writeNotifier = new QSocketNotifier( m_writeFd, QSocketNotifier::Write, this );
+    m_writeNotifier->setEnabled(false);
+    connect( m_writeNotifier, SIGNAL(activated(int)), this, SLOT(writeReady()) );
+  }
+}
+
+void TETransport::releaseDescriptors()
+{
+  stopThread(false);
+  delete m_readNotifier;
+  delete m_writeNotifier;
+  m_readNotifier = m_writeNotifier = 0;
+  m_readFd = m_writeFd = -1;
+}
+
+// Line settings, only meaningful for some backends ------------------------ --
+
+void TETransport::setSize(int, int)
+{
+}
+
+void TETransport::setErase(char)
+{
+}
+
+void TETransport::useUtf8(bool)
+{
+}
+
+bool TETransport::setFlowControl(FlowControl)
+{
+  return false;
+}
+
+bool TETransport::setSpeed(int)
+{
+  return false;
+}
+
+bool TETransport::setParity(Parity)
+{
+  return false;
+}
+
+bool TETransport::setBits(uint8_t)
+{
+  return false;
+}
+
+bool TETransport::setStopBits(uint8_t)
+{
+  return false;
+}
+
+bool TETransport::sendBreak()
+{
+  return false;
+}
+
+bool TETransport::startAutoBaud()
+{
+  return false;
+}
+
+/*!
+    Selects how the transport trades latency for throughput; here that
+    means the read coalescing window. Backends with a driver to tune do
+    that in their reimplementation.
+*/
+bool TETransport::setLatencyProfile(LatencyProfile profile)
+{
+  m_latencyProfile = profile;
+  setReadCoalesce(profile == lpThroughput ? THROUGHPUT_COALESCE_MSECS : 0);
+  return true;
+}
+
+// Receiving --------------------------------------------------------------- --
+
+/*!
+    sets the maximum number of bytes read from the line before the data
+    is handed to the emulation and control returns to the event loop.
+*/
+void TETransport::setReadBatchLimit(int bytes)
+{
+  m_readBatchLimit = QMAX(bytes, 1);
+}
+
+/*!
+    sets for how many milliseconds received data is left in the driver
+    after the line became readable, so that it is picked up in one go.
+    0 hands data out as soon as it arrives.
+*/
+void TETransport::setReadCoalesce(int msecs)
+{
+  m_coalesceMsecs = QMAX(msecs, 0);
+  if ( !m_coalesceMsecs && m_coalesceTimer->isActive() )
+    coalesceTimeout();
+}
+
+void TETransport::coalesceTimeout()
+{
+  m_coalesceTimer->stop();
+  if ( m_port || !m_readNotifier ) return;
+  // dataReceived() does not coalesce while the notifier is off
+  dataReceived();
+  if ( !m_readEof )
+    m_readNotifier->setEnabled(true);
+}
+
+/*!
+    Drains the line into the receive buffer and hands everything that
+    was read to the emulation as a single block.
+
+    FIONREAD tells how much the driver has queued, so normally a single
+    read() empties it; the loop only repeats when more data arrived in
+    the meanwhile. When the batch limit is reached the rest stays in the
+    driver, and since the descriptor is still readable the notifier
+    fires again on the next event loop iteration.
+*/
+void TETransport::dataReceived()
+{
+  if ( m_coalesceMsecs && !m_coalesceTimer->isActive() && m_readNotifier->isEnabled() )
+  {
+    // Leave the line alone for a while, unless it already has a full
+    // batch waiting.
+    int avail = 0;
+    if ( ioctl(m_readFd, FIONREAD, &avail) == 0 && avail < m_readBatchLimit )
+    {
+      m_readNotifier->setEnabled(false);
+      m_coalesceTimer->start(m_coalesceMsecs, true);
+      return;
+    }
+  }
+
+  m_readWakeups++;
+
+  bool first = true;
+  while ( (int)m_rxBuffer.size() < m_readBatchLimit )
+  {
+    int avail = 0;
+    if ( ioctl(m_readFd, FIONREAD, &avail) < 0 )
+      avail = 0;
+
+    if ( avail <= 0 )
+    {
+      // Nothing queued. Still try a read on the first pass, so that
+      // errors and hangups get noticed.
+      if ( !first ) break;
+      avail = 4096;
+    }
+    first = false;
+
+    int chunk = QMIN(avail, m_readBatchLimit - (int)m_rxBuffer.size());
+    int r = ::read( m_readFd, m_rxBuffer.reserve(chunk), chunk );
+    countRead(r);
+    if ( r < 0 )
+    {
+      if ( errno == EINTR ) continue;
+      if ( errno != EAGAIN )
+        kdWarning(1211) << "TETransport: read from " << m_name << " failed: "
+                        << strerror(errno) << endl;
+      break;
+    }
+    if ( r == 0 )
+    {
+      // End of file: a socket or pipe whose other end went away. Stop
+      // polling it, it would report readable forever.
+      if ( m_rxBuffer.isEmpty() )
+      {
+        m_readNotifier->setEnabled(false);
+        m_readEof = true;
+      }
+      break;
+    }
+
+    m_rxBuffer.commit(r);
+    if ( r < chunk ) break; // the driver is empty
+  }
+
+  int len = m_rxBuffer.size();
+  m_lastReadBatch = len;
+  if ( !len ) return;
+
+  m_bytesReceived += len;
+  const char *data = m_rxBuffer.linearize();
+  if ( m_capture )
+    m_capture->record(TECaptureWriter::Received, data, len);
+  emit block_in(data, len);
+  m_rxBuffer.clear();
+}
+
+void TETransport::deliver(const char *data, int len)
+{
+  if ( len <= 0 ) return;
+
+  m_readWakeups++;
+  m_lastReadBatch = len;
+  m_bytesReceived += len;
+  m_stats.bytesIn += len;
+  if ( m_capture )
+    m_capture->record(TECaptureWriter::Received, data, len);
+  emit block_in(data, len);
+}
+
+// Sending ----------------------------------------------------------------- --
+
+/*! sends a character through the line */
+void TETransport::send_byte(char c)
+{
+  send_bytes(&c,1);
+}
+
+/*! sends a 0 terminated string through the line */
+void TETransport::send_string(const char* s)
+{
+  send_bytes(s,strlen(s));
+}
+
+void TETransport::writeData(const char *, int)
+{
+}
+
+void TETransport::setReadingSuspended(bool on)
+{
+  if ( !m_readNotifier || m_port ) return;
+
+  m_coalesceTimer->stop();
+  m_readNotifier->setEnabled(!on && !m_readEof);
+}
+
+bool TETransport::lineCounters(TELineCounters *)
+{
+  return false;
+}
+
+void TETransport::writeReady()
+{
+  m_writeWakeups++;
+  flushSendBuffer();
+}
+
+/*!
+    Hands as much of the transmit queue to the driver as it accepts.
+
+    The queue is written with a single writev() even when it wraps
+    around the end of the ring. Whatever the driver did not take stays
+    queued for the next write notification.
+*/
+void TETransport::flushSendBuffer()
+{
+  while ( !m_txBuffer.isEmpty() )
+  {
+    struct iovec iov[2];
+    int n = m_txBuffer.spans(iov);
+    ssize_t total = iov[0].iov_len + (n > 1 ? iov[1].iov_len : 0);
+
+    ssize_t r = ::writev(m_writeFd, iov, n);
+    countWrite(r);
+    if ( r < 0 )
+    {
+      if ( errno == EINTR ) continue;
+      if ( errno == EAGAIN ) break;
+      kdWarning(1211) << "TETransport: write to " << m_name << " failed: "
+                      << strerror(errno) << ", dropping "
+                      << m_txBuffer.size() << " bytes" << endl;
+      m_txBuffer.clear();
+      break;
+    }
+
+    m_txBuffer.consume(r);
+    if ( r < total ) break; // the driver is full
+  }
+
+  if ( !m_port )
+    m_writeNotifier->setEnabled(!m_txBuffer.isEmpty());
+  checkWatermarks();
+}
+
+int TETransport::pendingBytes() const
+{
+  int pending = m_txBuffer.size();
+  if ( m_txRing )
+    pending += m_txRing->readAvailable();
+  return pending;
+}
+
+void TETransport::checkWatermarks()
+{
+  int pending = pendingBytes();
+  if ( m_aboveHighWatermark && pending <= m_lowWatermark )
+  {
+    m_aboveHighWatermark = false;
+    emit lowWatermark();
+  }
+  else if ( !m_aboveHighWatermark && pending >= m_highWatermark )
+  {
+    m_aboveHighWatermark = true;
+    emit highWatermark();
+  }
+}
+
+/*!
+    sets the transmit queue thresholds in bytes.
+
+    \sa highWatermark() lowWatermark()
+*/
+void TETransport::setWatermarks(int low, int high)
+{
+  m_lowWatermark = QMAX(low, 0);
+  m_highWatermark = QMAX(high, m_lowWatermark+1);
+  checkWatermarks();
+}
+
+/*! sends len bytes through the line
+
+    If nothing is queued the data is written straight from the caller's
+    buffer; only the part the driver does not accept is copied into the
+    transmit queue.
+*/
+void TETransport::send_bytes(const char* s, int len)
+{
+  if ( len <= 0 ) return;
+
+  if ( m_capture )
+    m_capture->record(TECaptureWriter::Sent, s, len);
+
+  if ( m_writeFd < 0 )
+  {
+    m_stats.bytesOut += len;
+    writeData(s, len);
+    return;
+  }
+
+  if ( m_port )
+  {
+    if ( m_txBuffer.isEmpty() )
+    {
+      size_t w = m_txRing->write(s, len);
+      s += w;
+      len -= w;
+    }
+    if ( len )
+      m_txBuffer.append(s, len);
+    if ( te_flag_take(&m_txIdle) )
+      wakeThread();
+    checkWatermarks();
+    return;
+  }
+
+  if ( m_txBuffer.isEmpty() )
+  {
+    ssize_t r;
+    do
+    {
+      r = ::write(m_writeFd, s, len);
+      countWrite(r);
+    }
+    while ( r < 0 && errno == EINTR );
+
+    if ( r < 0 && errno != EAGAIN )
+    {
+      kdWarning(1211) << "TETransport: write to " << m_name << " failed: "
+                      << strerror(errno) << endl;
+      return;
+    }
+    if ( r > 0 )
+    {
+      s += r;
+      len -= r;
+    }
+    if ( !len ) return;
+  }
+
+  // The driver is full; the rest goes out on the next write notification.
+  m_txBuffer.append(s, len);
+  m_writeNotifier->setEnabled(true);
+  checkWatermarks();
+}
+
+// Threaded mode ----------------------------------------------------------- --
+
+/*
+   In threaded mode the line is serviced by the shared TEReactor thread
+   instead of the socket notifiers, so a busy GUI thread (long repaints,
+   modal dialogs) no longer stops the line from being drained.
+
+   The reactor reads into m_rxRing and queues the transport for the GUI
+   thread; m_rxEventPending makes sure it is never queued twice for the
+   same data. The GUI thread hands the data to the emulation from
+   serviceEvents(). Outgoing data takes the opposite way through
+   m_txRing; what does not fit there waits in m_txBuffer on the GUI
+   side, so the watermarks work as in the unthreaded case.
+
+   When the reactor runs out of work for a line it raises m_rxStalled or
+   m_txIdle; the GUI thread clears the flag and kicks the reactor once
+   there is something to do again.
+*/
+
+/*!
+    Switches the line between being serviced by the GUI thread through
+    socket notifiers and being serviced by the shared I/O thread.
+
+    Returns false if the mode cannot be changed.
+*/
+bool TETransport::setThreaded(bool on)
+{
+#ifndef QT_THREAD_SUPPORT
+  if ( on )
+  {
+    kdWarning(1211) << "TETransport: built without thread support, threaded I/O is not available" << endl;
+    return false;
+  }
+  return true;
+#else
+  if ( on == isThreaded() ) return true;
+  if ( m_readFd < 0 || m_writeFd < 0 ) return !on;
+
+  if ( !on )
+  {
+    stopThread(true);
+    return true;
+  }
+
+  m_rxRing = new TESpscRing(THREAD_RX_RING_SIZE);
+  m_txRing = new TESpscRing(THREAD_TX_RING_SIZE);
+  m_rxEventPending = m_txEventPending = 0;
+  m_rxStalled = m_txIdle = 0;
+  m_rxError = 0;
+
+  if ( !TEReactor::instance()->add(this) )
+  {
+    delete m_rxRing;
+    delete m_txRing;
+    m_rxRing = m_txRing = 0;
+    return false;
+  }
+
+  m_coalesceTimer->stop();
+  m_readNotifier->setEnabled(false);
+  m_writeNotifier->setEnabled(false);
+
+  feedThread();
+  return true;
+#endif
+}
+
+/*!
+    Takes the line back from the I/O thread and returns it to the socket
+    notifiers. Received data not yet handed out is delivered if \a deliver
+    is set and dropped otherwise, as the session may be gone already;
+    unsent data is put back in front of the transmit queue.
+*/
+void TETransport::stopThread(bool deliver)
+{
+#ifdef QT_THREAD_SUPPORT
+  if ( !m_port ) return;
+
+  TEReactor::instance()->remove(this);
+
+  while ( deliver && deliverReceived(m_readBatchLimit) )
+    ;
+
+  if ( m_txRing->readAvailable() )
+  {
+    TERingBuffer unsent;
+    struct iovec iov[2];
+    int n = m_txRing->readSpans(iov);
+    for ( int i = 0; i < n; i++ )
+      unsent.append((const char*)iov[i].iov_base, iov[i].iov_len);
+    n = m_txBuffer.spans(iov);
+    for ( int i = 0; i < n; i++ )
+      unsent.append((const char*)iov[i].iov_base, iov[i].iov_len);
+
+    m_txBuffer.clear();
+    n = unsent.spans(iov);
+    for ( int i = 0; i < n; i++ )
+      m_txBuffer.append((const char*)iov[i].iov_base, iov[i].iov_len);
+  }
+
+  delete m_rxRing;
+  delete m_txRing;
+  m_rxRing = m_txRing = 0;
+
+  if ( m_readNotifier ) m_readNotifier->setEnabled(!m_readEof);
+  if ( m_writeNotifier ) m_writeNotifier->setEnabled(!m_txBuffer.isEmpty());
+#endif
+}
+
+void TETransport::setCapture(TECaptureWriter *capture)
+{
+#ifdef QT_THREAD_SUPPORT
+  if ( m_port )
+  {
+    TEReactor::instance()->setCapture(this, capture);
+    return;
+  }
+#endif
+  m_capture = capture;
+}
+
+void TETransport::wakeThread()
+{
+#ifdef QT_THREAD_SUPPORT
+  TEReactor::instance()->kick(this);
+#endif
+}
+
+/*!
+    Hands up to \a budget bytes from the receive ring to the emulation.
+    Returns true if more data is left in the ring.
+*/
+bool TETransport::deliverReceived(size_t budget)
+{
+  m_readWakeups++;
+
+  struct iovec iov[2];
+  int n = m_rxRing->readSpans(iov);
+  size_t total = 0;
+  for ( int i = 0; i < n && total < budget; i++ )
+  {
+    size_t len = QMIN(iov[i].iov_len, budget - total);
+    emit block_in((const char*)iov[i].iov_base, len);
+    m_rxRing->consume(len);
+    total += len;
+  }
+
+  m_lastReadBatch = total;
+  m_bytesReceived += total;
+
+  if ( te_flag_take(&m_rxStalled) )
+    wakeThread();
+
+  return m_rxRing->readAvailable() != 0;
+}
+
+/*!
+    Moves queued outgoing data into the transmit ring of the I/O thread.
+*/
+void TETransport::feedThread()
+{
+  while ( !m_txBuffer.isEmpty() )
+  {
+    size_t len;
+    const char *p = m_txBuffer.peek(&len);
+    size_t w = m_txRing->write(p, len);
+    m_txBuffer.consume(w);
+    if ( w < len ) break;
+  }
+
+  if ( te_flag_take(&m_txIdle) )
+    wakeThread();
+}
+
+/*!
+    Called by the reactor on the GUI thread when the I/O thread received
+    data for this line or sent some of its queue.
+*/
+void TETransport::serviceEvents()
+{
+#ifdef QT_THREAD_SUPPORT
+  if ( !m_port ) return;
+
+  if ( m_rxEventPending )
+  {
+    te_flag_clear(&m_rxEventPending);
+    if ( m_rxError )
+    {
+      kdWarning(1211) << "TETransport: read from " << m_name << " failed: "
+                      << strerror(m_rxError) << endl;
+      m_rxError = 0;
+    }
+    // Keep the batch bounded, the rest follows after the event loop
+    // had a chance to serve the other sessions.
+    if ( deliverReceived(m_readBatchLimit) && te_flag_raise(&m_rxEventPending) )
+      TEReactor::instance()->requeue(this);
+  }
+
+  if ( m_txEventPending )
+  {
+    te_flag_clear(&m_txEventPending);
+    m_writeWakeups++;
+    feedThread();
+    checkWatermarks();
+  }
+#endif
+}
+
+#include "TETransport.moc"
@@ -0,0 +1,312 @@
+/*
+    This file is part of Konsole, an X terminal.
+    Copyright (C) 2007 Diego Pettenò <flameeyes@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+#ifndef TE_TRANSPORT_H
+#define TE_TRANSPORT_H
+
+#include <config.h>
+
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include <qobject.h>
+#include <qsocketnotifier.h>
+#include <stdint.h>
+
+#include "TERingBuffer.h"
+
+class QTimer;
+class TESpscRing;
+class TEReactor;
+struct TEReactorPort;
+class TECaptureWriter;
+
+// Buckets of the read size histogram: bucket n counts the reads that
+// returned 2^n to 2^(n+1)-1 bytes, the last one everything larger.
+#define TESTATS_READ_BUCKETS 21
+
+/*!
+    I/O counters of a transport. They are updated by whichever thread
+    services the line, so a copy taken while the line is busy may be a
+    few bytes behind.
+*/
+struct TETransportStats
+{
+    unsigned long long bytesIn;
+    unsigned long long bytesOut;
+    unsigned long readCalls;
+    unsigned long writeCalls;
+    unsigned long readSizes[TESTATS_READ_BUCKETS];
+};
+
+/*!
+    Error and traffic counters kept by a serial driver, counted from
+    the moment the line was opened.
+*/
+struct TELineCounters
+{
+    int rx, tx;
+    int frame;
+    int parity;
+    int overrun;      // the UART lost data
+    int bufOverrun;   // the driver's buffer lost data
+    int brk;
+};
+
+/*!
+    A byte source and sink a session talks to.
+
+    The transport does all the buffering: received data is drained in
+    batches and handed out with block_in(), outgoing data is queued
+    with watermarks, and the I/O can be moved to a thread of its own.
+    Backends only provide the descriptors, through setDescriptors(),
+    and whatever line settings they support; the defaults of the line
+    setting slots do nothing and return false.
+
+    Backends without a descriptor hand their data to deliver() instead.
+*/
+class TETransport : public QObject
+{
+Q_OBJECT
+
+  public:
+    enum FlowControl { fcNone, fcSoftware, fcHardware };
+    enum Parity { parNone, parEven, parOdd };
+    /*!
+        interactive wakes up for every byte and asks the driver for low
+        latency, throughput lets the data pile up for a few milliseconds
+        so that it is handled in fewer, larger batches.
+    */
+    enum LatencyProfile { lpInteractive, lpThroughput };
+
+    /*!
+        creates the transport for \a device: "unix:", "fifo:", "pty:"
+        and "playback:" select the respective backend, anything else is
+        a serial device node.
+    */
+    static TETransport *create(const QString &device);
+
+    TETransport(const QString &name);
+    virtual ~TETransport();
+
+    QString name() const { return m_name; }
+    QString error() { return m_strError; }
+    /*!
+        the device programs on the other end of the transport open, if
+        the transport makes one; null otherwise.
+    */
+    virtual QString peerName() const { return QString::null; }
+
+    virtual void setSize(int lines, int cols);
+    virtual void setErase(char erase);
+
+  public slots:
+    virtual void useUtf8(bool on);
+    virtual bool setFlowControl(FlowControl flow);
+    virtual bool setSpeed(int speed);
+    virtual bool setParity(Parity parity);
+    virtual bool setBits(uint8_t bits);
+    virtual bool setStopBits(uint8_t stopbits);
+    virtual bool sendBreak();
+    virtual bool startAutoBaud();
+
+    void send_bytes(const char* s, int len);
+
+    void setReadBatchLimit(int bytes);
+    bool setThreaded(bool on);
+
+    virtual bool setLatencyProfile(LatencyProfile profile);
+    void setReadCoalesce(int msecs);
+
+  signals:
+
+    /*!
+        emitted when a new block of data comes in.
+        \param s - the data
+        \param len - the length of the block
+    */
+    void block_in(const char* s, int len);
+
+    /*!
+        emitted when the amount of data waiting to be sent reaches
+        the high watermark. Producers should pause until lowWatermark().
+    */
+    void highWatermark();
+
+    /*!
+        emitted when the data waiting to be sent drops back to the
+        low watermark after highWatermark() was emitted.
+    */
+    void lowWatermark();
+
+    /*!
+        emitted when startAutoBaud() is done, with the speed the line
+        was set to or 0 if none could be detected.
+    */
+    void speedDetected(int speed);
+
+  public:
+    void send_byte(char s);
+    void send_string(const char* s);
+    bool buffer_full() { return m_aboveHighWatermark; }
+    int pendingBytes() const;
+    void setWatermarks(int low, int high);
+
+    int readBatchLimit() const { return m_readBatchLimit; }
+    LatencyProfile latencyProfile() const { return m_latencyProfile; }
+    /*! milliseconds the line is left alone after data arrives, 0 if off */
+    int readCoalesce() const { return m_coalesceMsecs; }
+
+    /*! number of read notifications handled so far */
+    unsigned long readWakeups() const { return m_readWakeups; }
+    /*! number of write notifications handled so far */
+    unsigned long writeWakeups() const { return m_writeWakeups; }
+    /*! number of bytes received so far */
+    unsigned long long bytesReceived() const { return m_bytesReceived; }
+    /*! size of the last block handed to the emulation */
+    int lastReadBatch() const { return m_lastReadBatch; }
+    /*! average number of bytes handed out per read notification */
+    double bytesPerWakeup() const
+    { return m_readWakeups ? double(m_bytesReceived) / m_readWakeups : 0.0; }
+
+    /*!
+        records all data received and sent from now on into \a capture,
+        0 stops recording. The capture is not owned by the transport.
+        In threaded mode the I/O thread records received data as soon
+        as it reads it.
+    */
+    void setCapture(TECaptureWriter *capture);
+    TECaptureWriter *capture() const { return m_capture; }
+
+    const TETransportStats &stats() const { return m_stats; }
+
+    /*!
+        fills in the driver's counters. Returns false if the transport
+        has no such thing.
+    */
+    virtual bool lineCounters(TELineCounters *counters);
+
+    /*! true if the transport is serviced by its own I/O thread */
+    bool isThreaded() const { return m_port != 0; }
+
+  protected:
+    /*!
+        starts servicing \a readFd and \a writeFd, which may be the same
+        descriptor. Both must be non-blocking. The transport does not
+        close them.
+    */
+    void setDescriptors(int readFd, int writeFd);
+
+    /*!
+        stops servicing the descriptors for good, dropping received data
+        not yet handed out. Backends call it before closing them.
+    */
+    void releaseDescriptors();
+
+    /*! hands data of a backend without descriptors to the session */
+    void deliver(const char *data, int len);
+
+    /*!
+        called with data sent while there is no write descriptor;
+        the default drops it.
+    */
+    virtual void writeData(const char *data, int len);
+
+    /*!
+        stops handing out received data while a backend reads the line
+        itself. Only for unthreaded mode.
+    */
+    void setReadingSuspended(bool on);
+
+    QString m_strError;
+
+  private:
+    void countRead(int r)
+    {
+      m_stats.readCalls++;
+      if ( r <= 0 ) return;
+      m_stats.bytesIn += r;
+      int bucket = 0;
+      while ( (r >>= 1) && bucket < TESTATS_READ_BUCKETS-1 )
+        bucket++;
+      m_stats.readSizes[bucket]++;
+    }
+    void countWrite(int r)
+    {
+      m_stats.writeCalls++;
+      if ( r > 0 ) m_stats.bytesOut += r;
+    }
+
+    void flushSendBuffer();
+    void checkWatermarks();
+
+    // threaded mode, see setThreaded()
+    friend class TEReactor;
+    void wakeThread();
+    void stopThread(bool deliver);
+    bool deliverReceived(size_t budget);
+    void feedThread();
+    void serviceEvents();
+
+  private slots:
+    void writeReady();
+    void dataReceived();
+    void coalesceTimeout();
+
+  private:
+    QString m_name;
+    int m_readFd;
+    int m_writeFd;
+
+    TERingBuffer m_rxBuffer;
+    int m_readBatchLimit;
+    unsigned long m_readWakeups;
+    unsigned long long m_bytesReceived;
+    int m_lastReadBatch;
+    unsigned long m_writeWakeups;
+
+    LatencyProfile m_latencyProfile;
+    volatile int m_coalesceMsecs; // also read by the I/O thread
+    QTimer *m_coalesceTimer;
+
+    TERingBuffer m_txBuffer;
+    int m_lowWatermark;
+    int m_highWatermark;
+
+    TECaptureWriter *m_capture;
+    TETransportStats m_stats;
+
+    QSocketNotifier *m_readNotifier;
+    QSocketNotifier *m_writeNotifier;
+
+    TEReactorPort *m_port; // set while in threaded mode
+    TESpscRing *m_rxRing; // I/O thread -> GUI thread
+    TESpscRing *m_txRing; // GUI thread -> I/O thread
+    volatile int m_rxEventPending;
+    volatile int m_txEventPending;
+    volatile int m_rxStalled; // I/O thread waits for room in m_rxRing
+    volatile int m_txIdle;    // I/O thread waits for data in m_txRing
+    volatile int m_rxError;   // errno of the read the I/O thread gave up on
+
+    bool m_aboveHighWatermark:1;
+    bool m_readEof:1; // the read notifier is off for good
+};
+
+#endif
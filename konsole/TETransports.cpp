@@ -0,0 +1,232 @@
+/*
+    This file is part of Konsole, an X terminal.
+    Copyright (C) 2007 Diego Pettenò <flameeyes@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+#include <termios.h>
+#include <pty.h>
+
+#include <qfile.h>
+
+#include <klocale.h>
+#include <kdebug.h>
+
+#include "TETransports.h"
+
+// UNIX domain socket ------------------------------------------------------ --
+
+TEUnixSocketTransport::TEUnixSocketTransport(const QString &path)
+  : TETransport("unix:" + path)
+  , m_fd(-1)
+{
+  QCString name = QFile::encodeName(path);
+  struct sockaddr_un addr;
+  if ( name.length() >= sizeof(addr.sun_path) )
+  {
+    m_strError = i18n("Socket path %1 is too long").arg(path);
+    kdWarning(1211) << "TEUnixSocketTransport: " << m_strError << endl;
+    return;
+  }
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, name.data());
+
+  m_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  // A local connect does not block, so it is done before switching
+  // the socket to non-blocking mode.
+  if ( m_fd < 0 || ::connect(m_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 )
+  {
+    m_strError = i18n("Cannot connect to %1: %2").arg(path).arg(strerror(errno));
+    kdWarning(1211) << "TEUnixSocketTransport: " << m_strError << endl;
+    if ( m_fd >= 0 ) ::close(m_fd);
+    m_fd = -1;
+    return;
+  }
+
+  fcntl(m_fd, F_SETFL, O_NONBLOCK);
+  setDescriptors(m_fd, m_fd);
+}
+
+TEUnixSocketTransport::~TEUnixSocketTransport()
+{
+  if ( m_fd < 0 ) return;
+
+  releaseDescriptors();
+  ::close(m_fd);
+}
+
+// Named pipes ------------------------------------------------------------- --
+
+/*
+   Both pipes are opened read-write: opening a FIFO for reading alone
+   blocks until there is a writer, and reading from it returns end of
+   file whenever the last writer goes away. Holding both ends ourselves
+   avoids both, the other side can come and go as it likes.
+*/
+
+TEFifoTransport::TEFifoTransport(const QString &paths)
+  : TETransport("fifo:" + paths)
+  , m_rxFd(-1)
+  , m_txFd(-1)
+{
+  QString rxPath = paths.section(',', 0, 0);
+  QString txPath = paths.section(',', 1);
+
+  m_rxFd = ::open(QFile::encodeName(rxPath), O_RDWR|O_NONBLOCK);
+  if ( m_rxFd < 0 )
+  {
+    m_strError = i18n("Cannot open %1: %2").arg(rxPath).arg(strerror(errno));
+    kdWarning(1211) << "TEFifoTransport: " << m_strError << endl;
+    return;
+  }
+
+  if ( !txPath.isEmpty() )
+  {
+    m_txFd = ::open(QFile::encodeName(txPath), O_RDWR|O_NONBLOCK);
+    if ( m_txFd < 0 )
+    {
+      m_strError = i18n("Cannot open %1: %2").arg(txPath).arg(strerror(errno));
+      kdWarning(1211) << "TEFifoTransport: " << m_strError << endl;
+    }
+  }
+
+  setDescriptors(m_rxFd, m_txFd);
+}
+
+TEFifoTransport::~TEFifoTransport()
+{
+  releaseDescriptors();
+  if ( m_rxFd >= 0 ) ::close(m_rxFd);
+  if ( m_txFd >= 0 ) ::close(m_txFd);
+}
+
+// Pty pair ---------------------------------------------------------------- --
+
+TEPtyTransport::TEPtyTransport()
+  : TETransport("pty:")
+  , m_master(-1)
+  , m_slave(-1)
+{
+  // The slave stays open here as well, otherwise the master reports a
+  // hangup until some program opens it.
+  if ( !openRaw(&m_master, &m_slave, &m_slaveName) )
+  {
+    m_strError = i18n("Cannot create a pty pair: %1").arg(strerror(errno));
+    kdWarning(1211) << "TEPtyTransport: " << m_strError << endl;
+    return;
+  }
+
+  kdDebug(1211) << "TEPtyTransport: the other end is " << m_slaveName << endl;
+  setDescriptors(m_master, m_master);
+}
+
+TEPtyTransport::~TEPtyTransport()
+{
+  if ( m_master < 0 ) return;
+
+  releaseDescriptors();
+  ::close(m_master);
+  ::close(m_slave);
+}
+
+bool TEPtyTransport::openRaw(int *master, int *slave, QString *slaveName)
+{
+  if ( openpty(master, slave, 0, 0, 0) < 0 )
+  {
+    *master = *slave = -1;
+    return false;
+  }
+
+  *slaveName = ttyname(*slave);
+  fcntl(*master, F_SETFL, O_NONBLOCK);
+
+  struct termios options;
+  tcgetattr(*slave, &options);
+  cfmakeraw(&options);
+  tcsetattr(*slave, TCSANOW, &options);
+  return true;
+}
+
+// Capture playback -------------------------------------------------------- --
+
+TEPlaybackTransport::TEPlaybackTransport(const QString &spec)
+  : TETransport("playback:" + spec)
+{
+  QString fileName = spec;
+  double speed = 1.0;
+  int comma = spec.findRev(',');
+  if ( comma >= 0 )
+  {
+    bool ok;
+    double s = spec.mid(comma+1).toDouble(&ok);
+    if ( ok )
+    {
+      fileName = spec.left(comma);
+      speed = s;
+    }
+  }
+
+  if ( !m_playback.open(fileName, speed) )
+  {
+    m_strError = i18n("Cannot open capture %1").arg(fileName);
+    kdWarning(1211) << "TEPlaybackTransport: " << m_strError << endl;
+    return;
+  }
+
+  connect( &m_timer, SIGNAL(timeout()), this, SLOT(feed()) );
+  m_timer.start(0, true);
+}
+
+TEPlaybackTransport::~TEPlaybackTransport()
+{
+  m_timer.stop();
+}
+
+/*!
+    Hands out everything whose recorded time has come, at most a read
+    batch per event loop iteration like a real line would.
+*/
+void TEPlaybackTransport::feed()
+{
+  TECaptureReader::Chunk chunk;
+  int batch = 0;
+  while ( batch < readBatchLimit() && m_playback.nextDue(&chunk) )
+  {
+    deliver(chunk.data, chunk.len);
+    batch += chunk.len;
+  }
+
+  if ( m_playback.atEnd() )
+  {
+    kdDebug(1211) << "TEPlaybackTransport: end of " << name() << endl;
+    m_playback.close();
+    return;
+  }
+
+  m_timer.start(m_playback.wait(), true);
+}
+
+#include "TETransports.moc"
@@ -0,0 +1,113 @@
+/*
+    This file is part of Konsole, an X terminal.
+    Copyright (C) 2007 Diego Pettenò <flameeyes@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+/*! \file TETransports.h
+    \brief The transports that are not a serial line.
+*/
+
+#ifndef TETRANSPORTS_H
+#define TETRANSPORTS_H
+
+#include <qtimer.h>
+
+#include "TETransport.h"
+#include "TECapture.h"
+
+/*!
+    A connection to a listening UNIX domain stream socket, such as the
+    ones of QEMU or socat.
+*/
+class TEUnixSocketTransport : public TETransport
+{
+Q_OBJECT
+
+public:
+    TEUnixSocketTransport(const QString &path);
+    ~TEUnixSocketTransport();
+
+private:
+    int m_fd;
+};
+
+/*!
+    A pair of named pipes, given as "receive[,send]". Without a send
+    pipe whatever the session sends is dropped.
+*/
+class TEFifoTransport : public TETransport
+{
+Q_OBJECT
+
+public:
+    TEFifoTransport(const QString &paths);
+    ~TEFifoTransport();
+
+private:
+    int m_rxFd;
+    int m_txFd;
+};
+
+/*!
+    The master side of a new pty pair. Programs talk to the session
+    through peerName() as if it was a serial device.
+*/
+class TEPtyTransport : public TETransport
+{
+Q_OBJECT
+
+public:
+    TEPtyTransport();
+    ~TEPtyTransport();
+
+    QString peerName() const { return m_slaveName; }
+
+    /*!
+        creates a pty pair with the slave in raw mode and the master
+        non-blocking. Returns false and leaves errno set on failure.
+    */
+    static bool openRaw(int *master, int *slave, QString *slaveName);
+
+private:
+    int m_master;
+    int m_slave;
+    QString m_slaveName;
+};
+
+/*!
+    Plays the received data of a capture back, given as "file[,speed]"
+    where speed multiplies the recorded pace and 0 plays as fast as the
+    session takes the data. What the session sends is dropped.
+*/
+class TEPlaybackTransport : public TETransport
+{
+Q_OBJECT
+
+public:
+    TEPlaybackTransport(const QString &spec);
+    ~TEPlaybackTransport();
+
+private slots:
+    void feed();
+
+private:
+    TECapturePlayback m_playback;
+    QTimer m_timer;
+};
+
+#endif // TETRANSPORTS_H
@@ -29,6 +29,8 @@
 
 /*! \class TETty
 
+    The serial line backend of TETransport: a device node with its
+    termios settings.
 */
 #ifdef HAVE_CONFIG_H
 #include <config.h>
@@ -36,17 +38,21 @@
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/ioctl.h>
 #include <unistd.h>
 #include <errno.h>
+#include <string.h>
 #include <termios.h>
 #include <fcntl.h>
-                     
+
 #include <kstandarddirs.h>
 #include <klocale.h>
 #include <kdebug.h>
 #include <kpty.h>
 
 #include "TETty.h"
+#include "TEAutoBaud.h"
+#include "konsole_baud.h"
 
 #ifdef HAVE_TERMIOS_H
 /* for HP-UX (some versions) the extern C is needed, and for other
@@ -83,6 +89,10 @@ extern "C" {
 # endif
 #endif
 
+#if defined(__linux__)
+# include <linux/serial.h>
+#endif
+
 #if defined (_HPUX_SOURCE)
 # define _TERMIOS_INCLUDED
 # include <bsdtty.h>
@@ -124,6 +134,8 @@ void TETty::useUtf8(bool on)
 
 void TETty::setErase(char erase)
 {
+  if ( ttyfd < 0 ) return;
+
   struct ::termios tios;
   
   _tcgetattr(ttyfd, &tios);
@@ -159,38 +171,99 @@ bool TETty::setFlowControl(FlowControl flow)
   return true;
 }
 
+static const struct { int rate; speed_t constant; } baudrates[] = {
+  { 50, B50 }, { 75, B75 }, { 110, B110 }, { 134, B134 }, { 150, B150 },
+  { 200, B200 }, { 300, B300 }, { 600, B600 }, { 1200, B1200 },
+  { 1800, B1800 }, { 2400, B2400 }, { 4800, B4800 }, { 9600, B9600 },
+  { 19200, B19200 }, { 38400, B38400 },
+#ifdef B57600
+  { 57600, B57600 },
+#endif
+#ifdef B115200
+  { 115200, B115200 },
+#endif
+#ifdef B230400
+  { 230400, B230400 },
+#endif
+#ifdef B460800
+  { 460800, B460800 },
+#endif
+#ifdef B500000
+  { 500000, B500000 },
+#endif
+#ifdef B576000
+  { 576000, B576000 },
+#endif
+#ifdef B921600
+  { 921600, B921600 },
+#endif
+#ifdef B1000000
+  { 1000000, B1000000 },
+#endif
+#ifdef B1152000
+  { 1152000, B1152000 },
+#endif
+#ifdef B1500000
+  { 1500000, B1500000 },
+#endif
+#ifdef B2000000
+  { 2000000, B2000000 },
+#endif
+#ifdef B2500000
+  { 2500000, B2500000 },
+#endif
+#ifdef B3000000
+  { 3000000, B3000000 },
+#endif
+#ifdef B3500000
+  { 3500000, B3500000 },
+#endif
+#ifdef B4000000
+  { 4000000, B4000000 },
+#endif
+};
+
+/*!
+    Sets the line speed in bits per second.
+
+    Rates with a termios constant are set the usual way; anything else
+    is passed to the driver as a custom rate where the system supports
+    that (termios2 on Linux). The driver may round the rate to what
+    the hardware can do, see actualSpeed().
+*/
 bool TETty::setSpeed(int speed) {
   if ( ttyfd < 0 ) return false;
 
-  static const int baudrates[] = {
-    300, 600, 1200, 2400, 4800, 9600,
-    19200, 38400, 57600, 115200
-  };
-  static const int baudconsts[] = {
-    B300, B600, B1200, B2400, B4800, B9600,
-    B19200, B38400, B57600, B115200, -1
-  };
-
   size_t i;
   for (i = 0; i < sizeof(baudrates)/sizeof(baudrates[0]); i++)
-    if ( baudrates[i] == speed ) break;
-
-  if ( baudconsts[i] == -1 ) {
-    qWarning("Invalid or unsupported speed %d", speed);
-    return false;
-  }
+    if ( baudrates[i].rate == speed ) break;
 
-  struct ::termios options;
+  if ( i < sizeof(baudrates)/sizeof(baudrates[0]) )
+  {
+    struct ::termios options;
 
-  _tcgetattr(ttyfd, &options);
-  cfsetispeed(&options, baudconsts[i]);
-  cfsetospeed(&options, baudconsts[i]);
+    _tcgetattr(ttyfd, &options);
+    cfsetispeed(&options, baudrates[i].constant);
+    cfsetospeed(&options, baudrates[i].constant);
 
-  if ( _tcsetattr(ttyfd, &options) < 0 ) {
-    qWarning("Speed %d cannot be set.", speed);
+    if ( _tcsetattr(ttyfd, &options) < 0 ) {
+      qWarning("Speed %d cannot be set.", speed);
+      return false;
+    }
+  }
+  else if ( konsole_set_custom_baud(ttyfd, speed) < 0 )
+  {
+    qWarning("Invalid or unsupported speed %d", speed);
     return false;
   }
 
+  m_actualSpeed = konsole_get_baud(ttyfd);
+  if ( m_actualSpeed <= 0 )
+    m_actualSpeed = speed; // no way to ask, trust the request
+  else if ( m_actualSpeed != speed )
+    kdWarning(1211) << "TETty: requested " << speed << " baud on " << ttyName
+                    << ", the driver set " << m_actualSpeed << endl;
+
   return true;
 }
 
@@ -271,11 +344,20 @@ bool TETty::setStopBits(uint8_t stopbits) {
     Create an instance.
 */
 TETty::TETty(const QString &_tty)
+  : TETransport(_tty)
+  , m_actualSpeed(0)
+  , m_autoBaud(0)
+  , m_threadedBeforeAutoBaud(false)
 {
-  m_bufferFull = false;
   ttyName = _tty;
 
   ttyfd = open(ttyName.latin1(), O_RDWR|O_NOCTTY|O_NONBLOCK);
+  if ( ttyfd < 0 )
+  {
+    m_strError = i18n("Cannot open %1: %2").arg(ttyName).arg(strerror(errno));
+    kdWarning(1211) << "TETty: " << m_strError << endl;
+    return;
+  }
 
   // without the '::' some version of HP-UX thinks, this declares
   // the struct in this class, in this method, and fails to find
@@ -289,10 +371,10 @@ TETty::TETty(const QString &_tty)
   options.c_iflag = 0;
   _tcsetattr(ttyfd, &options);
 
-  m_readNotifier = new QSocketNotifier( ttyfd, QSocketNotifier::Read, this );
-  connect( m_readNotifier, SIGNAL(activated(int)), this, SLOT(dataReceived()) );
-  m_writeNotifier = new QSocketNotifier( ttyfd, QSocketNotifier::Write, this );
-  connect( m_writeNotifier, SIGNAL(activated(int)), this, SLOT(writeReady()) );
+  if ( !readCounters(&m_countersBase) )
+    memset(&m_countersBase, 0, sizeof(m_countersBase));
+
+  setDescriptors(ttyfd, ttyfd);
 }
 
 /*!
@@ -300,66 +382,151 @@ TETty::TETty(const QString &_tty)
 */
 TETty::~TETty()
 {
-  delete m_readNotifier;
-  delete m_writeNotifier;
+  if ( ttyfd < 0 ) return;
+
+  // the I/O thread must be gone before the descriptor is closed
+  releaseDescriptors();
   close(ttyfd);
 }
 
-void TETty::dataReceived()
+/*!
+    Selects how the line trades latency for throughput.
+
+    The descriptor is non-blocking, so VMIN/VTIME do not delay read()
+    itself, but with VTIME 0 the driver only reports the line readable
+    once VMIN bytes are queued. Both profiles therefore use VMIN 1 and
+    VTIME 0 rather than whatever the device was left with; trailing
+    bytes of a burst would otherwise never be reported. The batching of
+    the throughput profile comes from the read coalescing window.
+*/
+bool TETty::setLatencyProfile(LatencyProfile profile)
 {
-  char buffer[4096] = { 0, };
-  int r = read( ttyfd, buffer, 4095 );
+  if ( ttyfd < 0 ) return false;
 
-  emit block_in(buffer, r);
+  struct ::termios options;
+  _tcgetattr(ttyfd, &options);
+  options.c_cc[VMIN] = 1;
+  options.c_cc[VTIME] = 0;
+  if ( _tcsetattr(ttyfd, &options) < 0 ) {
+    qWarning("Latency profile %d cannot be set.", profile);
+    return false;
+  }
+
+  setLowLatency(profile == lpInteractive);
+  return TETransport::setLatencyProfile(profile);
 }
 
-/*! sends a character through the line */
-void TETty::send_byte(char c)
+/*!
+    Sets or clears the low latency flag of the serial driver. USB
+    adapters in particular hold received data back for up to 16 ms
+    without it.
+
+    Returns false if the driver has no such flag, as is the case for
+    ptys; that is not an error worth reporting.
+*/
+bool TETty::setLowLatency(bool on)
 {
-  send_bytes(&c,1);
+#if defined(TIOCGSERIAL) && defined(ASYNC_LOW_LATENCY)
+  struct serial_struct serial;
+  if ( ioctl(ttyfd, TIOCGSERIAL, &serial) < 0 )
+    return false;
+
+  if ( on )
+    serial.flags |= ASYNC_LOW_LATENCY;
+  else
+    serial.flags &= ~ASYNC_LOW_LATENCY;
+
+  if ( ioctl(ttyfd, TIOCSSERIAL, &serial) < 0 )
+  {
+    kdDebug(1211) << "TETty: cannot change low latency mode of " << ttyName
+                  << ": " << strerror(errno) << endl;
+    return false;
+  }
+  return true;
+#else
+  Q_UNUSED(on);
+  return false;
+#endif
 }
 
-/*! sends a 0 terminated string through the line */
-void TETty::send_string(const char* s)
+bool TETty::readCounters(TELineCounters *counters)
 {
-  send_bytes(s,strlen(s));
+#ifdef TIOCGICOUNT
+  struct serial_icounter_struct icount;
+  if ( ttyfd < 0 || ioctl(ttyfd, TIOCGICOUNT, &icount) < 0 )
+    return false;
+
+  counters->rx = icount.rx;
+  counters->tx = icount.tx;
+  counters->frame = icount.frame;
+  counters->parity = icount.parity;
+  counters->overrun = icount.overrun;
+  counters->bufOverrun = icount.buf_overrun;
+  counters->brk = icount.brk;
+  return true;
+#else
+  Q_UNUSED(counters);
+  return false;
+#endif
 }
 
-void TETty::writeReady()
+/*!
+    The counters are kept by the driver for as long as the port exists;
+    what is reported here is the difference to when this line was
+    opened. Ptys and some USB adapters have no counters at all.
+*/
+bool TETty::lineCounters(TELineCounters *counters)
 {
-  m_bufferFull = false;
-  doSendJobs();
+  if ( !readCounters(counters) )
+    return false;
+
+  counters->rx -= m_countersBase.rx;
+  counters->tx -= m_countersBase.tx;
+  counters->frame -= m_countersBase.frame;
+  counters->parity -= m_countersBase.parity;
+  counters->overrun -= m_countersBase.overrun;
+  counters->bufOverrun -= m_countersBase.bufOverrun;
+  counters->brk -= m_countersBase.brk;
+  return true;
 }
 
-void TETty::doSendJobs() {
-  if(pendingSendJobs.isEmpty())
-  {
-     emit buffer_empty();
-     return;
-  }
-  
-  SendJob& job = pendingSendJobs.first();
-  int result = ::write(ttyfd, job.buffer.data(), job.length);
-  if ( result < 0 )
+/*!
+    Detects the speed the device sends at, see TEAutoBaud. Received data
+    is not handed out meanwhile; speedDetected() is emitted when done.
+*/
+bool TETty::startAutoBaud()
+{
+  if ( ttyfd < 0 || m_autoBaud ) return false;
+
+  m_threadedBeforeAutoBaud = isThreaded();
+  setThreaded(false);
+  setReadingSuspended(true);
+
+  m_autoBaud = new TEAutoBaud(this, ttyfd);
+  connect( m_autoBaud, SIGNAL(finished(int)), this, SLOT(autoBaudFinished(int)) );
+  if ( !m_autoBaud->start() )
   {
-    qWarning("Uh oh.. can't write data..");
-    return;
+    delete m_autoBaud;
+    m_autoBaud = 0;
+    setReadingSuspended(false);
+    setThreaded(m_threadedBeforeAutoBaud);
+    return false;
   }
-  pendingSendJobs.remove(pendingSendJobs.begin());
-  m_bufferFull = true;
+  return true;
 }
 
-void TETty::appendSendJob(const char* s, int len)
+void TETty::autoBaudFinished(int speed)
 {
-  pendingSendJobs.append(SendJob(s,len));
-}
+  m_autoBaud->deleteLater();
+  m_autoBaud = 0;
+  setReadingSuspended(false);
+  setThreaded(m_threadedBeforeAutoBaud);
 
-/*! sends len bytes through the line */
-void TETty::send_bytes(const char* s, int len)
-{
-  appendSendJob(s,len);
-  if (!m_bufferFull)
-     doSendJobs();
+  if ( speed )
+    kdDebug(1211) << "TETty: " << ttyName << " runs at " << speed << " baud" << endl;
+  else
+    kdWarning(1211) << "TETty: cannot detect the speed of " << ttyName << endl;
+  emit speedDetected(speed);
 }
 
 bool TETty::sendBreak()
@@ -23,14 +23,16 @@
 
 #include <config.h>
 
-#include <qsocketnotifier.h>
-#include <qstrlist.h>
-#include <qvaluelist.h>
-#include <qmemarray.h>
-
 #include <pty.h>
 
-class TETty : public QObject
+#include "TETransport.h"
+
+class TEAutoBaud;
+
+/*!
+    A serial device node.
+*/
+class TETty : public TETransport
 {
 Q_OBJECT
 
@@ -39,14 +41,13 @@ Q_OBJECT
     TETty(const QString &_tty);
     ~TETty();
 
-  public:
-    enum FlowControl { fcNone, fcSoftware, fcHardware };
-    enum Parity { parNone, parEven, parOdd };
-
-    QString error() { return m_strError; }
+    /*! the line speed the driver reports after setSpeed() */
+    int actualSpeed() const { return m_actualSpeed; }
     void setSize(int lines, int cols);
     void setErase(char erase);
 
+    bool lineCounters(TELineCounters *counters);
+
   public slots:
     void useUtf8(bool on);
     bool setFlowControl(FlowControl flow);
@@ -54,59 +55,29 @@ Q_OBJECT
     bool setParity(Parity parity);
     bool setBits(uint8_t bits);
     bool setStopBits(uint8_t stopbits);
-
-    void send_bytes(const char* s, int len);
     bool sendBreak();
+    bool startAutoBaud();
 
-  signals:
-
-    /*!
-        emitted when a new block of data comes in.
-        \param s - the data
-        \param len - the length of the block
-    */
-    void block_in(const char* s, int len);
-    
-    /*!
-        emitted when buffer_full becomes false
-    */
-    void buffer_empty();
+    bool setLatencyProfile(LatencyProfile profile);
 
   public:
-    void send_byte(char s);
-    void send_string(const char* s);
-    bool buffer_full() { return m_bufferFull; }
-
-  private:
-    void appendSendJob(const char* s, int len);
+    /*! true while startAutoBaud() is listening to the line */
+    bool isDetectingSpeed() const { return m_autoBaud != 0; }
 
   private slots:
-    void doSendJobs();
-    void writeReady();
-    void dataReceived();
+    void autoBaudFinished(int speed);
 
   private:
+    bool setLowLatency(bool on);
+    bool readCounters(TELineCounters *counters);
 
-    QString m_strError;
-
-    struct SendJob {
-      SendJob() {}
-      SendJob(const char* b, int len) {
-        buffer.duplicate(b,len);
-        length = len;
-      }
-      QMemArray<char> buffer;
-      int length;
-    };
-    QValueList<SendJob> pendingSendJobs;
     int ttyfd;
     QString ttyName;
     struct winsize winSize;
-
-    QSocketNotifier *m_readNotifier;
-    QSocketNotifier *m_writeNotifier;
-
-    bool m_bufferFull:1;
+    int m_actualSpeed;
+    TELineCounters m_countersBase; // the driver's counters when opened
+    TEAutoBaud *m_autoBaud;
+    bool m_threadedBeforeAutoBaud;
 };
 
 #endif
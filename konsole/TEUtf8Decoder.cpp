@@ -0,0 +1,96 @@
+/*
+    This file is part of Konsole, an X terminal.
+    Copyright (C) 2007 Diego Pettenò <flameeyes@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+#include <qstring.h>
+
+#include "TEUtf8Decoder.h"
+#include "konsole_scan.h"
+
+#define REPLACEMENT 0xfffd
+
+int TEUtf8Decoder::decode(const char *s, int len, unsigned short *out)
+{
+  const unsigned char *p = (const unsigned char*) s;
+  int o = 0;
+  int i = 0;
+
+  while ( i < len )
+  {
+    if ( !m_need )
+    {
+      int n = konsole_ascii_run(s + i, len - i);
+      for ( int j = 0; j < n; j++ )
+        out[o + j] = p[i + j];
+      i += n;
+      o += n;
+      if ( i == len )
+        break;
+
+      unsigned char c = p[i++];
+      if ( c >= 0xc2 && c <= 0xdf )      { m_need = 1; m_cp = c & 0x1f; m_min = 0x80; }
+      else if ( c >= 0xe0 && c <= 0xef ) { m_need = 2; m_cp = c & 0x0f; m_min = 0x800; }
+      else if ( c >= 0xf0 && c <= 0xf4 ) { m_need = 3; m_cp = c & 0x07; m_min = 0x10000; }
+      else
+        out[o++] = REPLACEMENT; // continuation without a lead, or never valid
+      continue;
+    }
+
+    unsigned char c = p[i];
+    if ( (c & 0xc0) != 0x80 )
+    {
+      // Cut short; the byte starts afresh.
+      out[o++] = REPLACEMENT;
+      m_need = 0;
+      continue;
+    }
+    i++;
+
+    m_cp = (m_cp << 6) | (c & 0x3f);
+    if ( --m_need )
+      continue;
+
+    if ( m_cp < m_min || (m_cp >= 0xd800 && m_cp <= 0xdfff) || m_cp > 0xffff )
+      out[o++] = REPLACEMENT;
+    else
+      out[o++] = m_cp;
+  }
+
+  return o;
+}
+
+bool TEUtf8Decoder::isCombining(unsigned short c)
+{
+  // One bit per character of the BMP, filled in from Qt's character
+  // database on first use.
+  static unsigned char table[0x10000 / 8];
+  static bool init = false;
+
+  if ( c < 0x300 )
+    return false;
+
+  if ( !init )
+  {
+    for ( unsigned int u = 0x300; u < 0x10000; u++ )
+      if ( QChar((unsigned short) u).category() == QChar::Mark_NonSpacing )
+        table[u >> 3] |= 1 << (u & 7);
+    init = true;
+  }
+  return table[c >> 3] & (1 << (c & 7));
+}
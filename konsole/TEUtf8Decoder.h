@@ -0,0 +1,67 @@
+/*
+    This file is part of Konsole, an X terminal.
+    Copyright (C) 2007 Diego Pettenò <flameeyes@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+/*! \file TEUtf8Decoder.h
+    \brief Decoding UTF-8 as it arrives.
+*/
+
+#ifndef TEUTF8DECODER_H
+#define TEUTF8DECODER_H
+
+/*!
+    A UTF-8 decoder for the receive path, which carries characters
+    split between blocks over to the next one.
+
+    Malformed input comes out as U+FFFD, one for each bad byte or cut
+    short sequence. So does everything outside the Basic Multilingual
+    Plane, since the screen keeps 16 bits per cell.
+*/
+class TEUtf8Decoder
+{
+public:
+    TEUtf8Decoder() { reset(); }
+
+    void reset() { m_need = 0; }
+
+    /*! true while part of a character is held back */
+    bool pending() const { return m_need != 0; }
+
+    /*!
+        decodes \a len bytes into \a out, which must have room for
+        \a len + 1 characters, and returns the number of characters.
+    */
+    int decode(const char *s, int len, unsigned short *out);
+
+    /*!
+        drops a character cut short, returning true if there was one.
+        For when a control code interrupts it.
+    */
+    bool flush() { bool had = m_need != 0; m_need = 0; return had; }
+
+    /*! true for the non-spacing marks that combine with the character before */
+    static bool isCombining(unsigned short c);
+
+private:
+    int m_need;          // continuation bytes still to come
+    unsigned int m_cp;   // the character so far
+    unsigned int m_min;  // smallest character its length may encode
+};
+
+#endif // TEUTF8DECODER_H
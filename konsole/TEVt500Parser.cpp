@@ -0,0 +1,212 @@
+/*
+    This file is part of Konsole, an X terminal.
+    Copyright (C) 2007 Diego Pettenò <flameeyes@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+#include "TEVt500Parser.h"
+#include "TEVt500States.h"
+#include "vt500table.h"
+
+// Nobody sends more parameters than this in earnest; more are dropped.
+#define MAX_PARAMS 1024
+// Larger values are clamped, which is what a terminal does with them
+// anyway.
+#define MAX_PARAM_VALUE 65535
+// Longest operating system command kept, in characters.
+#define MAX_OSC 4096
+
+#define ESC 27
+#define CAN 24
+#define SUB 26
+
+TEVt500Parser::TEVt500Parser(TEVt500Sink *sink)
+  : m_sink(sink)
+  , m_params(16)
+{
+  reset();
+}
+
+void TEVt500Parser::reset()
+{
+  m_state = VT500_GROUND;
+  m_vt52State = 0;
+  m_vt52Row = 0;
+  perform(VT500_CLEAR, 0);
+  m_osc = QString::null;
+}
+
+void TEVt500Parser::feed(int cc)
+{
+  unsigned char t = vt500_table[m_state][cc < VT500_GR ? cc : VT500_GR];
+  int next = t & 0x0f;
+
+  if ( next == VT500_STAY )
+  {
+    perform(t >> 4, cc);
+    return;
+  }
+
+  // Most states have neither an exit nor an entry action.
+  if ( vt500_exit[m_state] )
+    perform(vt500_exit[m_state], cc);
+  if ( t >> 4 )
+    perform(t >> 4, cc);
+  m_state = next;
+  if ( vt500_entry[next] )
+    perform(vt500_entry[next], cc);
+}
+
+void TEVt500Parser::nextParam()
+{
+  if ( m_count == MAX_PARAMS )
+  {
+    m_paramsFull = true;
+    return;
+  }
+  if ( m_count == (int)m_params.size() )
+    m_params.resize(QMIN(2 * m_count, MAX_PARAMS));
+  m_params[m_count++] = 0;
+}
+
+void TEVt500Parser::perform(int action, int cc)
+{
+  switch ( action )
+  {
+    case VT500_PRINT:
+      m_sink->vtPrint(cc);
+      break;
+
+    case VT500_EXECUTE:
+      m_sink->vtExecute(cc);
+      break;
+
+    case VT500_CLEAR:
+      m_marker = 0;
+      m_intermediate = 0;
+      m_intermediates = 0;
+      m_count = 0;
+      m_paramsFull = false;
+      break;
+
+    case VT500_COLLECT:
+      if ( cc >= 0x3c )
+        m_marker = cc;
+      else if ( !m_intermediates++ )
+        m_intermediate = cc;
+      break;
+
+    case VT500_PARAM:
+      if ( !m_count )
+        nextParam();
+      if ( cc == ';' || cc == ':' )
+        nextParam();
+      else if ( !m_paramsFull )
+      {
+        int &p = m_params[m_count-1];
+        p = QMIN(10 * p + (cc - '0'), MAX_PARAM_VALUE);
+      }
+      break;
+
+    case VT500_ESC_DISPATCH:
+      if ( m_intermediates <= 1 )
+        m_sink->vtEscDispatch(cc, m_intermediate);
+      break;
+
+    case VT500_CSI_DISPATCH:
+      csiDispatch(cc);
+      break;
+
+    case VT500_OSC_START:
+      m_osc = "";
+      break;
+
+    case VT500_OSC_PUT:
+      if ( m_osc.length() < MAX_OSC )
+        m_osc += QChar((ushort)cc);
+      break;
+
+    case VT500_OSC_END:
+      // Cancelled rather than terminated.
+      if ( cc != CAN && cc != SUB )
+        m_sink->vtOscDispatch(m_osc);
+      m_osc = QString::null;
+      break;
+  }
+}
+
+void TEVt500Parser::csiDispatch(int cc)
+{
+  if ( m_intermediates > 1 )
+    return;
+  if ( !m_count )
+    nextParam();
+  m_sink->vtCsiDispatch(cc, m_marker, m_intermediate, m_params.data(), m_count);
+}
+
+/*
+   VT52 sequences are ESC and a command, with two more characters for
+   the row and column of ESC Y. Controls act within a sequence as they
+   do in ANSI mode.
+*/
+
+void TEVt500Parser::feedVt52(int cc)
+{
+  if ( cc == 127 )
+    return;
+
+  if ( cc == ESC )
+  {
+    m_vt52State = 1;
+    return;
+  }
+
+  if ( cc < 32 )
+  {
+    if ( cc == CAN || cc == SUB )
+      m_vt52State = 0;
+    m_sink->vtExecute(cc);
+    return;
+  }
+
+  switch ( m_vt52State )
+  {
+    case 0:
+      m_sink->vtPrint(cc);
+      break;
+
+    case 1:
+      if ( cc == 'Y' )
+      {
+        m_vt52State = 2;
+        return;
+      }
+      m_vt52State = 0;
+      m_sink->vtVt52Dispatch(cc, 0, 0);
+      break;
+
+    case 2:
+      m_vt52Row = cc;
+      m_vt52State = 3;
+      break;
+
+    case 3:
+      m_vt52State = 0;
+      m_sink->vtVt52Dispatch('Y', m_vt52Row, cc);
+      break;
+  }
+}
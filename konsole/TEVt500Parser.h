@@ -0,0 +1,107 @@
+/*
+    This file is part of Konsole, an X terminal.
+    Copyright (C) 2007 Diego Pettenò <flameeyes@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+/*! \file TEVt500Parser.h
+    \brief Table driven parser for DEC/ANSI escape sequences.
+*/
+
+#ifndef TEVT500PARSER_H
+#define TEVT500PARSER_H
+
+#include <qmemarray.h>
+#include <qstring.h>
+
+/*!
+    What the parser finds in the stream, in the terms of the DEC/ANSI
+    standards rather than of any particular terminal.
+*/
+class TEVt500Sink
+{
+public:
+    virtual ~TEVt500Sink() {}
+
+    /*! a graphic character */
+    virtual void vtPrint(int cc) = 0;
+    /*! a C0 or C1 control function */
+    virtual void vtExecute(int cc) = 0;
+    /*! ESC, the \a intermediate (0 if none) and \a final character */
+    virtual void vtEscDispatch(int final, int intermediate) = 0;
+    /*!
+        a control sequence. \a marker is the private parameter marker,
+        one of "<=>?" or 0. There is at least one parameter, missing
+        ones are 0.
+    */
+    virtual void vtCsiDispatch(int final, int marker, int intermediate,
+                               const int *params, int count) = 0;
+    /*! an operating system command, without its terminator */
+    virtual void vtOscDispatch(const QString &text) = 0;
+    /*! a VT52 escape; \a row and \a col are only set for ESC Y */
+    virtual void vtVt52Dispatch(int cmd, int row, int col) = 0;
+};
+
+/*!
+    Splits the stream of characters into graphic characters, control
+    functions and escape sequences, following the state machine of the
+    VT500 series. The transitions come from the table vt500gen builds,
+    and parameters are accumulated as they come in, so a character
+    costs a table lookup and rarely more.
+
+    There is no fixed limit to the number of parameters or the length
+    of an operating system command; what goes beyond a sane size is
+    dropped instead of growing the parser without bounds.
+
+    VT52 mode has a grammar of its own and is parsed with feedVt52().
+*/
+class TEVt500Parser
+{
+public:
+    TEVt500Parser(TEVt500Sink *sink);
+
+    void feed(int cc);
+    void feedVt52(int cc);
+
+    /*! forgets any sequence in progress */
+    void reset();
+
+    /*! true unless in the middle of a sequence */
+    bool isGround() const { return m_state == 0; }
+
+private:
+    void perform(int action, int cc);
+    void nextParam();
+    void csiDispatch(int cc);
+
+    TEVt500Sink *m_sink;
+    int m_state;
+    int m_vt52State;
+    int m_vt52Row;
+
+    int m_marker;
+    int m_intermediate;
+    int m_intermediates;  // how many were collected; more than one is invalid
+
+    QMemArray<int> m_params;
+    int m_count;
+    bool m_paramsFull;
+
+    QString m_osc;
+};
+
+#endif // TEVT500PARSER_H
@@ -0,0 +1,67 @@
+/*
+    This file is part of Konsole, an X terminal.
+    Copyright (C) 2007 Diego Pettenò <flameeyes@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+/*! \file TEVt500States.h
+    \brief States and actions of the DEC/ANSI parser, shared between
+    TEVt500Parser and the generator of its table.
+*/
+
+#ifndef TEVT500STATES_H
+#define TEVT500STATES_H
+
+enum VT500State {
+  VT500_GROUND,
+  VT500_ESCAPE,
+  VT500_ESCAPE_INTERMEDIATE,
+  VT500_CSI_ENTRY,
+  VT500_CSI_PARAM,
+  VT500_CSI_INTERMEDIATE,
+  VT500_CSI_IGNORE,
+  VT500_DCS_ENTRY,
+  VT500_DCS_PARAM,
+  VT500_DCS_INTERMEDIATE,
+  VT500_DCS_PASSTHROUGH,
+  VT500_DCS_IGNORE,
+  VT500_OSC_STRING,
+  VT500_SOS_PM_APC_STRING,
+  VT500_STATES,
+
+  VT500_STAY = 15   // in the table: no change of state
+};
+
+enum VT500Action {
+  VT500_NONE,
+  VT500_IGNORE,
+  VT500_PRINT,
+  VT500_EXECUTE,
+  VT500_CLEAR,
+  VT500_COLLECT,
+  VT500_PARAM,
+  VT500_ESC_DISPATCH,
+  VT500_CSI_DISPATCH,
+  VT500_OSC_START,
+  VT500_OSC_PUT,
+  VT500_OSC_END
+};
+
+// table column of all characters from 0xa0 up
+#define VT500_GR 0xa0
+
+#endif // TEVT500STATES_H
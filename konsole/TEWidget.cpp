@@ -340,6 +340,7 @@ TEWidget::TEWidget(QWidget *parent, const char *name)
 ,contentHeight(1)
 ,contentWidth(1)
 ,image(0)
+,image_stale(true)
 ,resizing(false)
 ,terminalSizeHint(false)
 ,terminalSizeStartup(true)
@@ -601,11 +602,12 @@ void TEWidget::drawAttrStr(QPainter &paint, QRect rect,
                            QString& str, const ca *attr, bool pm, bool clear)
 {
   int a = font_a + m_lineSpacing / 2;
-  QColor fColor = printerFriendly ? Qt::black : attr->f.color(color_table);
-  QColor bColor = attr->b.color(color_table);
+  const castyle &st = castyle::at(attr->s);
+  QColor fColor = printerFriendly ? Qt::black : st.f.color(color_table);
+  QColor bColor = st.b.color(color_table);
   QString drawstr;
 
-  if ((attr->r & RE_CURSOR) && !isPrinting)
+  if ((st.r & RE_CURSOR) && !isPrinting)
     cursorRect = rect;
 
   // Paint background
@@ -615,13 +617,13 @@ void TEWidget::drawAttrStr(QPainter &paint, QRect rect,
     {
       if (pm)
         paint.setBackgroundMode( TransparentMode );
-      if (clear || (blinking && (attr->r & RE_BLINK)))
+      if (clear || (blinking && (st.r & RE_BLINK)))
         erase(rect);
     }
     else
     {
-      if (pm || clear || (blinking && (attr->r & RE_BLINK)) ||
-          attr->b == cacol(CO_DFT, colorsSwapped ? DEFAULT_FORE_COLOR : DEFAULT_BACK_COLOR) )
+      if (pm || clear || (blinking && (st.r & RE_BLINK)) ||
+          st.b == cacol(CO_DFT, colorsSwapped ? DEFAULT_FORE_COLOR : DEFAULT_BACK_COLOR) )
 
         // draw background colors with 75% opacity
         if ( argb_visual && qAlpha(blend_color) < 0xff ) {
@@ -672,7 +674,7 @@ void TEWidget::drawAttrStr(QPainter &paint, QRect rect,
   }
 
   // Paint cursor
-  if ((attr->r & RE_CURSOR) && !isPrinting) {
+  if ((st.r & RE_CURSOR) && !isPrinting) {
     paint.setBackgroundMode( TransparentMode );
     int h = font_h - m_lineSpacing;
     QRect r(rect.x(),rect.y()+m_lineSpacing/2,rect.width(),h);
@@ -691,7 +693,7 @@ void TEWidget::drawAttrStr(QPainter &paint, QRect rect,
     }
   }
 
-  if (!(blinking && (attr->r & RE_BLINK)))
+  if (!(blinking && (st.r & RE_BLINK)))
   {
     // ### Disabled for now, since it causes problems with characters
     // that use the full width and/or height of the character cells.
@@ -765,7 +767,7 @@ void TEWidget::drawAttrStr(QPainter &paint, QRect rect,
       }
       paint.setClipping(false);
     }
-    if (attr->r & RE_UNDERLINE)
+    if (st.r & RE_UNDERLINE)
       paint.drawLine(rect.left(), rect.y()+a+1,
                      rect.right(),rect.y()+a+1 );
   }
@@ -796,9 +798,13 @@ void TEWidget::setCursorPos(const int curx, const int cury)
     The image can only be set completely.
 
     The size of the new image may or may not match the size of the widget.
+
+    If \a dirty is given, lines for which it is 0 are known not to have
+    changed since the last image and are skipped without comparing them,
+    unless the widget has lost track of what it shows since.
 */
 
-void TEWidget::setImage(const ca* const newimg, int lines, int columns)
+void TEWidget::setImage(const ca* const newimg, int lines, int columns, const char *dirty)
 {
   if (!image)
      updateImageSize(); // Create image
@@ -814,20 +820,31 @@ void TEWidget::setImage(const ca* const newimg, int lines, int columns)
   int    tLy = tL.y();
   hasBlinker = false;
 
-  cacol cf;       // undefined
-  cacol cb;       // undefined
-  int   cr  = -1; // undefined
+  UINT16 cs;      // style
 
   int lins = QMIN(this->lines,  QMAX(0,lines  ));
   int cols = QMIN(this->columns,QMAX(0,columns));
   QChar *disstrU = new QChar[cols];
   char *dirtyMask = (char *) malloc(cols+2);
 
+  // The input method preedit is drawn over lines the image knows nothing of.
+  if (image_stale || m_imPreeditLength > 0)
+     dirty = 0;
+  if ((int) blink_lines.size() != this->lines)
+  {
+     blink_lines.resize(this->lines);
+     blink_lines.fill(false);
+  }
+
 //{ static int cnt = 0; printf("setImage %d\n",cnt++); }
   for (y = 0; y < lins; y++)
   {
+    if (dirty && !dirty[y])
+      continue;
+
     const ca*       lcl = &image[y*this->columns];
     const ca* const ext = &newimg[y*columns];
+    bool lineBlinks = false;
 
     // The dirty mask indicates which characters need repainting. We also
     // mark surrounding neighbours dirty, in case the character exceeds
@@ -843,13 +860,19 @@ void TEWidget::setImage(const ca* const newimg, int lines, int columns)
       {
          dirtyMask[x] = dirtyMask[x+1] = dirtyMask[x+2] = 1;
       }
+      else if (m_imPreeditLength == 0)
+      {
+         // skip what is unchanged two cells at a time
+         while (x+2 < cols && equalPair(&ext[x+1], &lcl[x+1]))
+            x += 2;
+      }
     }
     dirtyMask++; // Position correctly
 
     if (!resizing) // not while resizing, we're expecting a paintEvent
     for (x = 0; x < cols; x++)
     {
-      hasBlinker |= (ext[x].r & RE_BLINK);
+      lineBlinks |= (ext[x].r() & RE_BLINK);
       // Start drawing if this character or the next one differs.
       // We also take the next one into account to handle the situation
       // where characters exceed their cell width.
@@ -862,9 +885,7 @@ void TEWidget::setImage(const ca* const newimg, int lines, int columns)
         disstrU[p++] = c; //fontMap(c);
         bool lineDraw = isLineChar(c);
         bool doubleWidth = (ext[x+1].c == 0);
-        cr = ext[x].r;
-        cb = ext[x].b;
-        if (ext[x].f != cf) cf = ext[x].f;
+        cs = ext[x].s;
         int lln = cols - x;
         for (len = 1; len < lln; len++)
         {
@@ -872,7 +893,7 @@ void TEWidget::setImage(const ca* const newimg, int lines, int columns)
           if (!c)
             continue; // Skip trailing part of multi-col chars.
 
-          if (ext[x+len].f != cf || ext[x+len].b != cb || ext[x+len].r != cr ||
+          if (ext[x+len].s != cs ||
               !dirtyMask[x+len] || isLineChar(c) != lineDraw || (ext[x+len+1].c == 0) != doubleWidth)
             break;
 
@@ -912,10 +933,14 @@ void TEWidget::setImage(const ca* const newimg, int lines, int columns)
     }
 
     dirtyMask--; // Set back
+    blink_lines[y] = lineBlinks;
 
     // finally, make `image' become `newimg'.
     memcpy((void*)lcl,(const void*)ext,cols*sizeof(ca));
   }
+  image_stale = false;
+  for (y = 0; y < lins && !hasBlinker; y++)
+    hasBlinker = blink_lines[y];
   drawFrame( &paint );
   paint.end();
   setUpdatesEnabled(true);
@@ -959,6 +984,46 @@ void TEWidget::setImage(const ca* const newimg, int lines, int columns)
   }
 }
 
+/*!
+    moves the lines \a top to \a bottom of the image up by \a n lines, or
+    down if \a n is negative, as the emulation scrolled them before the
+    image handed to the next setImage(). The pixels are moved along, so
+    that only the lines uncovered have to be drawn, which are blank until
+    then.
+
+    This is not possible over a background pixmap, which stays where it
+    is, nor under the input method's preedit text or while resizing. The
+    next setImage() then looks at all lines instead.
+*/
+
+void TEWidget::scrollImage(int n, int top, int bottom)
+{
+  if (!image || image_stale || n == 0)
+    return;
+  if (backgroundPixmap() || m_imPreeditLength > 0 || resizing ||
+      top < 0 || bottom >= lines || QABS(n) > bottom-top ||
+      (int) blink_lines.size() != lines)
+  {
+    image_stale = true;
+    return;
+  }
+
+  int moved = bottom-top+1-QABS(n);
+  int to = n > 0 ? top : top-n;
+  memmove(&image[to*columns], &image[(to+n)*columns], moved*columns*sizeof(ca));
+  for (int i = 0; i < moved; i++)
+    blink_lines[to+i] = blink_lines[to+n+i];
+  int from = n > 0 ? top+moved : top;
+  for (int i = from*columns; i < (from+QABS(n))*columns; i++)
+    image[i] = ca();
+  for (int y = from; y < from+QABS(n); y++)
+    blink_lines[y] = false;
+
+  QPoint tL = contentsRect().topLeft();
+  scroll(0, -n*font_h, QRect(bX+tL.x(), bY+tL.y()+font_h*top,
+                             font_w*columns, font_h*(bottom-top+1)));
+}
+
 void TEWidget::setBlinkingCursor(bool blink)
 {
   hasBlinkingCursor=blink;
@@ -1109,13 +1174,10 @@ void TEWidget::paintContents(QPainter &paint, const QRect &rect, bool pm)
          disstrU[p++] = c; //fontMap(c);
       bool lineDraw = isLineChar(c);
       bool doubleWidth = (image[loc(x,y)+1].c == 0);
-      cacol cf = image[loc(x,y)].f;
-      cacol cb = image[loc(x,y)].b;
-      int   cr = image[loc(x,y)].r;
+      UINT16 cs = image[loc(x,y)].s;
+      int    cr = image[loc(x,y)].r();
       while (x+len <= rlx &&
-             image[loc(x+len,y)].f == cf &&
-             image[loc(x+len,y)].b == cb &&
-             image[loc(x+len,y)].r == cr &&
+             image[loc(x+len,y)].s == cs &&
              (image[loc(x+len,y)+1].c == 0) == doubleWidth &&
              isLineChar( c = image[loc(x+len,y)].c) == lineDraw) // Assignment!
       {
@@ -2085,10 +2147,7 @@ void TEWidget::clearImage()
   // We initialize image[image_size] too. See makeImage()
   for (int i = 0; i <= image_size; i++)
   {
-    image[i].c = ' ';
-    image[i].f = cacol(CO_DFT,DEFAULT_FORE_COLOR);
-    image[i].b = cacol(CO_DFT,DEFAULT_BACK_COLOR);
-    image[i].r = DEFAULT_RENDITION;
+    image[i] = ca();
   }
 }
 
@@ -2142,6 +2201,7 @@ void TEWidget::makeImage()
   // We over-commit 1 character so that we can be more relaxed in dealing with
   // certain boundary conditions: image[image_size] is a valid but unused position
   image = (ca*) malloc((image_size+1)*sizeof(ca));
+  image_stale = true;
   clearImage();
 }
 
@@ -80,7 +80,10 @@ public:
     void emitSelection(bool useXselection,bool appendReturn);
     void emitText(QString text);
 
-    void setImage(const ca* const newimg, int lines, int columns);
+    void setImage(const ca* const newimg, int lines, int columns, const char *dirty = 0);
+    void scrollImage(int n, int top, int bottom);
+    /*! whether the widget has lost track of the image it was last given */
+    bool imageStale() const { return image_stale; }
     void setLineWrapped(QBitArray line_wrapped) { m_line_wrapped=line_wrapped; }
 
     void setCursorPos(const int curx, const int cury);
@@ -243,6 +246,9 @@ private:
     int contentWidth;
     ca *image; // [lines][columns]
     int image_size;
+    bool image_stale;      // image may not be what was last set, or
+                           // not what the next dirty lines are relative to
+    QBitArray blink_lines; // [lines] lines with characters to blink
     QBitArray m_line_wrapped;
 
     ColorEntry color_table[TABLE_COLORS];
@@ -78,7 +78,10 @@
 /*!
 */
 
-TEmuVt102::TEmuVt102(TEWidget* gui) : TEmulation(gui)
+TEmuVt102::TEmuVt102(TEWidget* gui)
+  : TEmulation(gui)
+  , m_parser(this)
+  , m_legacyParser(false)
 {
   //kdDebug(1211)<<"TEmuVt102 ctor() connecting"<<endl;
   QObject::connect(gui,SIGNAL(mouseSignal(int,int,int)),
@@ -131,6 +134,7 @@ void TEmuVt102::reset()
 {
   //kdDebug(1211)<<"TEmuVt102::reset() resetToken()"<<endl;
   resetToken();
+  m_parser.reset();
   //kdDebug(1211)<<"TEmuVt102::reset() resetModes()"<<endl;
   resetModes();
   //kdDebug(1211)<<"TEmuVt102::reset() resetCharSet()"<<endl;
@@ -161,7 +165,7 @@ void TEmuVt102::reset()
 
    The pipeline proceeds as follows:
 
-   - Tokenizing the ESC codes (onRcvChar)
+   - Parsing the ESC codes (onRcvChar, TEVt500Parser)
    - VT100 code page translation of plain characters (applyCharset)
    - Interpretation of ESC codes (tau)
 
@@ -310,6 +314,23 @@ void TEmuVt102::initTokenizer()
 // process an incoming unicode character
 
 void TEmuVt102::onRcvChar(int cc)
+{
+  if (m_legacyParser)
+    onRcvCharLegacy(cc);
+  else if (getMode(MODE_Ansi))
+    m_parser.feed(cc);
+  else
+    m_parser.feedVt52(cc);
+}
+
+void TEmuVt102::setLegacyParser(bool on)
+{
+  m_legacyParser = on;
+  resetToken();
+  m_parser.reset();
+}
+
+void TEmuVt102::onRcvCharLegacy(int cc)
 { int i;
   if (cc == 127) return; //VT100: ignore.
 
@@ -330,7 +351,7 @@ void TEmuVt102::onRcvChar(int cc)
   if (getMode(MODE_Ansi)) // decide on proper action
   {
     if (lec(1,0,ESC)) {                                                       return; }
-    if (lec(1,0,ESC+128)) { s[0] = ESC; onRcvChar('[');                       return; }
+    if (lec(1,0,ESC+128)) { s[0] = ESC; onRcvCharLegacy('[');                 return; }
     if (les(2,1,GRP)) {                                                       return; }
     if (Xte         ) { XtermHack();                            resetToken(); return; }
     if (Xpe         ) {                                                       return; }
@@ -391,6 +412,105 @@ void TEmuVt102::XtermHack()
   delete [] str;
 }
 
+/*
+   The events of the parser, mapped onto the tokens above so that the
+   interpretation stays the same for both.
+*/
+
+void TEmuVt102::vtPrint(int cc)
+{
+  tau( TY_CHR(), applyCharset(cc), 0);
+}
+
+void TEmuVt102::vtExecute(int cc)
+{
+  if (cc < 32) { tau( TY_CTL(cc+'@'), 0, 0); return; }
+
+  // The C1 controls that have a 7 bit equivalent handled in tau()
+  switch (cc)
+  {
+    case 0x84 : tau( TY_ESC('D'), 0, 0); break; // IND
+    case 0x85 : tau( TY_ESC('E'), 0, 0); break; // NEL
+    case 0x88 : tau( TY_ESC('H'), 0, 0); break; // HTS
+    case 0x8d : tau( TY_ESC('M'), 0, 0); break; // RI
+  }
+}
+
+void TEmuVt102::vtEscDispatch(int final, int intermediate)
+{
+  // ST: the ESC already ended the string it terminates
+  if (final == '\\' && !intermediate)
+    return;
+  if (!intermediate)
+    tau( TY_ESC(final), 0, 0);
+  else if (intermediate == '#')
+    tau( TY_ESC_DE(final), 0, 0);
+  else if (tbl[intermediate] & SCS)
+    tau( TY_ESC_CS(intermediate, final), 0, 0);
+}
+
+void TEmuVt102::vtCsiDispatch(int final, int marker, int intermediate,
+                              const int *argv, int count)
+{ int i;
+  int argc = count - 1;
+
+  if (intermediate)
+  {
+    if (intermediate == '!' && !marker) tau( TY_CSI_PE(final), 0, 0);
+    return;
+  }
+
+  switch (marker)
+  {
+    case '?' : for (i = 0; i <= argc; i++) tau( TY_CSI_PR(final, argv[i]), 0, 0);
+               return;
+    case '>' : tau( TY_CSI_PG(final), 0, 0); // spec. case for ESC]>0c or ESC]>c
+               return;
+    case 0   : break;
+    default  : return;
+  }
+
+  if (tbl[final] & CPN) { tau( TY_CSI_PN(final), argv[0], argc >= 1 ? argv[1] : 0); return; }
+
+// resize = \e[8;<row>;<col>t
+  if (tbl[final] & CPS)
+  {
+    tau( TY_CSI_PS(final, argv[0]), argc >= 1 ? argv[1] : 0, argc >= 2 ? argv[2] : 0);
+    return;
+  }
+
+  for (i = 0; i <= argc; i++)
+  if (final == 'm' && argc - i >= 4 && (argv[i] == 38 || argv[i] == 48) && argv[i+1] == 2)
+  { // ESC[ ... 48;2;<red>;<green>;<blue> ... m -or- ESC[ ... 38;2;<red>;<green>;<blue> ... m
+    i += 2;
+    tau( TY_CSI_PS(final, argv[i-2]), CO_RGB, (argv[i] << 16) | (argv[i+1] << 8) | argv[i+2]);
+    i += 2;
+  }
+  else if (final == 'm' && argc - i >= 2 && (argv[i] == 38 || argv[i] == 48) && argv[i+1] == 5)
+  { // ESC[ ... 48;5;<index> ... m -or- ESC[ ... 38;5;<index> ... m
+    i += 2;
+    tau( TY_CSI_PS(final, argv[i-2]), CO_256, argv[i]);
+  }
+  else { tau( TY_CSI_PS(final, argv[i]), 0, 0); }
+}
+
+void TEmuVt102::vtOscDispatch(const QString &text)
+{
+  uint i;
+  int arg = 0;
+  for (i = 0; i < text.length() && text[i].isDigit(); i++)
+    arg = 10*arg + text[i].digitValue();
+  if (i == text.length() || text[i] != ';') return;
+  // arg == 1 doesn't change the title. In XTerm it only changes the icon name
+  // (btw: arg=0 changes title and icon, arg=1 only icon, arg=2 only title
+  emit changeTitle(arg, text.mid(i+1));
+}
+
+void TEmuVt102::vtVt52Dispatch(int cmd, int row, int col)
+{
+  tau( TY_VT52(cmd), row, col);
+}
+
 // Interpreting Codes ---------------------------------------------------------
 
 /*
@@ -767,7 +887,7 @@ switch( N )
 
     case TY_CSI_PG('c'      ) :  reportSecondaryAttributes(          ); break; //VT100
 
-    default : ReportErrorToken();    break;
+    default : ReportErrorToken(token, p, q); break;
   };
 }
 
@@ -1033,6 +1153,59 @@ unsigned short TEmuVt102::applyCharset(unsigned short c)
   return c;
 }
 
+/*
+   Printable ASCII outside of an escape sequence is always shown as it
+   is, so runs of it skip the tokenizer. What belongs to a sequence in
+   progress still goes through onRcvChar until the sequence is done.
+   The rest is handed to the screen in one go, through the character
+   set if one that translates is in use.
+*/
+
+void TEmuVt102::onRcvPrintable(const char *s, int len)
+{
+  if (!getMode(MODE_Ansi))
+  {
+    TEmulation::onRcvPrintable(s, len);
+    return;
+  }
+
+  int i = 0;
+  while (i < len && !parserIdle())
+    onRcvChar((unsigned char) s[i++]);
+
+  bool translate = CHARSET.graphic || CHARSET.pound;
+  unsigned short buf[256];
+  while (i < len)
+  {
+    int n = QMIN(len-i, 256);
+    for (int j = 0; j < n; j++)
+      buf[j] = translate ? applyCharset((unsigned char) s[i+j]) : (unsigned char) s[i+j];
+    scr->ShowCharacters(buf, n);
+    i += n;
+  }
+}
+
+/*
+   Decoded text is never changed by the character sets, which only
+   apply to ASCII, so it goes to the screen as it is.
+*/
+
+void TEmuVt102::onRcvText(const unsigned short *s, int len)
+{
+  if (!getMode(MODE_Ansi))
+  {
+    TEmulation::onRcvText(s, len);
+    return;
+  }
+
+  int i = 0;
+  while (i < len && !parserIdle())
+    onRcvChar(s[i++]);
+
+  if (i < len)
+    scr->ShowCharacters(s+i, len-i);
+}
+
 /*
    "Charset" related part of the emulation state.
    This configures the VT100 charset filter.
@@ -1266,13 +1439,46 @@ void TEmuVt102::scan_buffer_report()
   printf("token: "); hexdump(pbuf,ppos); printf("\n");
 }
 
+#ifndef NDEBUG
+/*! prints the sequence \a token was made from, as far as it tells. */
+
+static void tokenReport(int token, int p, int q)
+{
+  int N = token & 0xff;
+  int A = (token >> 8) & 0xff;
+  int B = (token >> 16) & 0xffff;
+  switch (N)
+  {
+    case  1: printf("^%c", A);                  break;
+    case  2: printf("ESC %c", A);               break;
+    case  3: printf("ESC %c %c", A, B);         break;
+    case  4: printf("ESC # %c", A);             break;
+    case  5: printf("CSI %d %c", B, A);         break;
+    case  6: printf("CSI %d;%d %c", p, q, A);   break;
+    case  7: printf("CSI ? %d %c", B, A);       break;
+    case  8: printf("ESC %c (VT52)", A);        break;
+    case  9: printf("CSI > %c", A);             break;
+    case 10: printf("CSI ! %c", A);             break;
+    default: printf("0x%08x", token);           break;
+  }
+}
+#endif
+
 /*!
+    reports a sequence the emulation does not handle. The legacy parser
+    still holds the raw sequence in its scan buffer; the state machine
+    parser does not keep one, so the dispatched \a token is shown instead.
 */
 
-void TEmuVt102::ReportErrorToken()
+void TEmuVt102::ReportErrorToken(int token, int p, int q)
 {
 #ifndef NDEBUG
-  printf("undecodable "); scan_buffer_report();
+  if (m_legacyParser)
+  {
+    printf("undecodable "); scan_buffer_report();
+    return;
+  }
+  printf("undecodable token: "); tokenReport(token, p, q); printf("\n");
 #endif
 }
 
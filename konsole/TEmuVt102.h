@@ -24,6 +24,7 @@
 #include "TEWidget.h"
 #include "TEScreen.h"
 #include "TEmulation.h"
+#include "TEVt500Parser.h"
 #include <stdio.h>
 
 //
@@ -51,7 +52,7 @@ struct CharCodes
   bool sa_pound;   // saved pound
 };
 
-class TEmuVt102 : public TEmulation
+class TEmuVt102 : public TEmulation, public TEVt500Sink
 { Q_OBJECT
 
 public:
@@ -75,6 +76,11 @@ public:
   void reset();
 
   void onRcvChar(int cc);
+  void onRcvPrintable(const char *s, int len);
+  void onRcvText(const unsigned short *s, int len);
+
+  void setLegacyParser(bool on);
+  bool legacyParser() const { return m_legacyParser; }
 public slots:
   void sendString(const char *);
 
@@ -92,8 +98,24 @@ public:
   
   char getErase();
 
+protected: // TEVt500Sink
+
+  void vtPrint(int cc);
+  void vtExecute(int cc);
+  void vtEscDispatch(int final, int intermediate);
+  void vtCsiDispatch(int final, int marker, int intermediate,
+                     const int *params, int count);
+  void vtOscDispatch(const QString &text);
+  void vtVt52Dispatch(int cmd, int row, int col);
+
 private:
 
+  TEVt500Parser m_parser;
+  bool m_legacyParser;
+  bool parserIdle() const { return m_legacyParser ? ppos == 0 : m_parser.isGround(); }
+
+  // the tokenizer the parser replaced, kept to compare against
+  void onRcvCharLegacy(int cc);
   void resetToken();
 #define MAXPBUF 80
   void pushToToken(int cc);
@@ -108,7 +130,7 @@ private:
   int tbl[256];
 
   void scan_buffer_report(); //FIXME: rename
-  void ReportErrorToken();   //FIXME: rename
+  void ReportErrorToken(int token = 0, int p = 0, int q = 0); //FIXME: rename
 
   void tau(int code, int p, int q);
   void XtermHack();
@@ -52,16 +52,17 @@
 
    We use a refreshing algorithm here that has been adoped from rxvt/kvt.
 
-   By this, refreshing is driven by a timer, which is (re)started whenever
-   a new bunch of data to be interpreted by the emulation arives at `onRcvBlock'.
-   As soon as no more data arrive for `BULK_TIMEOUT' milliseconds, we trigger
-   refresh. This rule suits both bulk display operation as done by curses as
-   well as individual characters typed.
-
-   We start also a second time which is never restarted. If repeatedly
-   restarting of the first timer could delay continuous output indefinitly,
-   the second timer guarantees that the output is refreshed with at least
-   a fixed rate.
+   By this, refreshing is driven by a timer, which is started whenever
+   a new bunch of data to be interpreted by the emulation arives at `onRcvBlock'
+   and no refresh is pending yet. Data arriving after the display has been
+   idle for a frame budget is shown right after it was interpreted, so that
+   individual characters typed are echoed without delay. Under continuous
+   output, refreshes are paced to one per frame budget, and everything that
+   arrives in between is shown by the same refresh.
+
+   When interpreting alone took up a whole frame budget, the emulation is
+   behind and the refresh is skipped in favour of the data, up to
+   `MAX_SKIPPED_FRAMES' times in a row.
 */
 
 /* FIXME
@@ -71,6 +72,8 @@
 #include "TEmulation.h"
 #include "TEWidget.h"
 #include "TEScreen.h"
+#include "konsole_scan.h"
+#include "TEClock.h"
 #include <kdebug.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -90,6 +93,9 @@
 
 #define CNTL(c) ((c)-'@')
 
+#define DEFAULT_FRAME_BUDGET 16 // milliseconds, about 60 frames per second
+#define MAX_SKIPPED_FRAMES 3
+
 /*!
 */
 
@@ -100,7 +106,20 @@ TEmulation::TEmulation(TEWidget* w)
   listenToKeyPress(false),
   m_codec(0),
   decoder(0),
+  m_inSequence(false),
+  m_isUtf8(false),
   keytrans(0),
+  m_frameBudget(DEFAULT_FRAME_BUDGET),
+  m_lastFrame(0),
+  m_parseUsecs(0),
+  m_skippedRun(0),
+  m_frames(0),
+  m_skippedFrames(0),
+  m_fpsFrames(0),
+  m_fpsStart(0),
+  m_fps(0),
+  m_shownScreen(0),
+  m_shownGeneration(0),
   m_findPos(-1)
 {
 
@@ -108,8 +127,7 @@ TEmulation::TEmulation(TEWidget* w)
   screen[1] = new TEScreen(gui->Lines(),gui->Columns());
   scr = screen[0];
 
-  QObject::connect(&bulk_timer1, SIGNAL(timeout()), this, SLOT(showBulk()) );
-  QObject::connect(&bulk_timer2, SIGNAL(timeout()), this, SLOT(showBulk()) );
+  QObject::connect(&m_frameTimer, SIGNAL(timeout()), this, SLOT(showFrame()) );
   connectGUI();
   setKeymap(0); // Default keymap
 }
@@ -167,6 +185,7 @@ void TEmulation::changeGUI(TEWidget* newgui)
                      this,SLOT(testIsSelected(const int, const int, bool &)) );
   }
   gui=newgui;
+  m_shownScreen = 0;
   connectGUI();
 }
 
@@ -209,6 +228,9 @@ void TEmulation::setCodec(const QTextCodec * qtc)
   m_codec = qtc;
   delete decoder;
   decoder = m_codec->makeDecoder();
+  m_inSequence = false;
+  m_isUtf8 = utf8();
+  m_utf8.reset();
   emit useUtf8(utf8());
 }
 
@@ -267,6 +289,27 @@ void TEmulation::onRcvChar(int c)
   };
 }
 
+/*!
+   A run of printable ASCII, which needs no decoding. Emulations that
+   can show it without looking at every character override this.
+*/
+void TEmulation::onRcvPrintable(const char *s, int len)
+{
+  for (int i = 0; i < len; i++)
+    onRcvChar((unsigned char) s[i]);
+}
+
+/*!
+   A run of decoded graphic characters from U+00A0 up, none of them
+   combining. Like onRcvPrintable(), for emulations that can do better
+   than one character at a time.
+*/
+void TEmulation::onRcvText(const unsigned short *s, int len)
+{
+  for (int i = 0; i < len; i++)
+    onRcvChar(s[i]);
+}
+
 /* ------------------------------------------------------------------------- */
 /*                                                                           */
 /*                             Keyboard Handling                             */
@@ -306,13 +349,36 @@ void TEmulation::onRcvBlock(const char *s, int len)
 {
   emit notifySessionState(NOTIFYACTIVITY);
 
+  unsigned long long start = now();
+  if (m_isUtf8)
+    onRcvUtf8(s, len);
+  else
+    onRcvLocale(s, len);
+  m_parseUsecs += now() - start;
+
   bulkStart();
+}
 
+void TEmulation::onRcvLocale(const char *s, int len)
+{
   QString r;
   int i, l;
 
   for (i = 0; i < len; i++)
   {
+    // Plain ASCII goes to the emulation in whole runs, unless the
+    // decoder is in the middle of a character.
+    if (!m_inSequence)
+    {
+      l = konsole_printable_run(s+i, len-i);
+      if (l)
+      {
+        onRcvPrintable(s+i, l);
+        i += l-1;
+        continue;
+      }
+    }
+
     // If we get a control code halfway a multi-byte sequence
     // we flush the decoder and continue with the control code.
     if ((unsigned char) s[i] < 32)
@@ -323,6 +389,7 @@ void TEmulation::onRcvBlock(const char *s, int len)
          while(!tmp.length())
              tmp = decoder->toUnicode(" ",1);
        }
+       m_inSequence = false;
 
        onRcvChar((unsigned char) s[i]);
 
@@ -338,6 +405,7 @@ void TEmulation::onRcvBlock(const char *s, int len)
          break;
 
     r = decoder->toUnicode(&s[i],l-i+1);
+    m_inSequence = (unsigned char) s[l] >= 0x80;
     int reslen = r.length();
 
     for (int j = 0; j < reslen; j++)
@@ -351,6 +419,76 @@ void TEmulation::onRcvBlock(const char *s, int len)
   }
 }
 
+/*
+   The UTF-8 decoder keeps characters split between blocks for the next
+   one, and decodes into a buffer that is kept around.
+*/
+
+void TEmulation::onRcvUtf8(const char *s, int len)
+{
+  if ((int) m_ucs.size() < len + 1)
+    m_ucs.resize(len + 1);
+  unsigned short *ucs = m_ucs.data();
+
+  int i = 0;
+  while (i < len)
+  {
+    unsigned char c = s[i];
+
+    if (!m_utf8.pending())
+    {
+      int l = konsole_printable_run(s+i, len-i);
+      if (l)
+      {
+        onRcvPrintable(s+i, l);
+        i += l;
+        continue;
+      }
+    }
+
+    if (c < 32)
+    {
+      // A control code cuts short a character in progress.
+      if (m_utf8.flush())
+        onRcvChar(0xfffd);
+      onRcvChar(c);
+
+      if (c == '\030' && (len-i-1 > 3) && (strncmp(s+i+1, "B00", 3) == 0))
+        emit zmodemDetected();
+      i++;
+      continue;
+    }
+
+    // Decode up to the next control code or printable ASCII. A
+    // character in progress takes at least the next byte.
+    int l = i + 1;
+    while (l < len && (unsigned char) s[l] >= 0x7f)
+      l++;
+
+    int n = m_utf8.decode(s+i, l-i, ucs);
+    int j = 0;
+    while (j < n)
+    {
+      int k = j;
+      while (k < n && ucs[k] >= 0xa0 && !TEUtf8Decoder::isCombining(ucs[k]))
+        k++;
+      if (k > j)
+      {
+        onRcvText(ucs+j, k-j);
+        j = k;
+        continue;
+      }
+
+      if (TEUtf8Decoder::isCombining(ucs[j]))
+        scr->compose(QString(QChar(ucs[j])));
+      else
+        onRcvChar(ucs[j]);
+      j++;
+    }
+    i = l;
+  }
+}
+
 // Selection --------------------------------------------------------------- --
 
 void TEmulation::onSelectionBegin(const int x, const int y, const bool columnmode) {
@@ -451,27 +589,41 @@ bool TEmulation::findTextNext( const QString &str, bool forward, bool caseSensit
 
 // Refreshing -------------------------------------------------------------- --
 
-#define BULK_TIMEOUT1 10
-#define BULK_TIMEOUT2 40
-
 /*!
 */
 
 void TEmulation::showBulk()
 {
-  bulk_timer1.stop();
-  bulk_timer2.stop();
+  m_frameTimer.stop();
+  m_lastFrame = now();
+  m_parseUsecs = 0;
+  m_skippedRun = 0;
 
   if (connected)
   {
-    ca* image = scr->getCookedImage();    // get the image
-    gui->setImage(image,
-                  scr->getLines(),
-                  scr->getColumns());     // actual refresh
+    m_frames++;
+    m_fpsFrames++;
+
+    // Only the lines that changed since the widget was last given this
+    // screen are handed on, and nothing at all if none did.
+    bool same = (scr == m_shownScreen);
+    if (!same || scr->generation() != m_shownGeneration || gui->imageStale())
+    {
+      const ca* image = scr->getCookedImage();    // get the image
+      int top, bottom;
+      int n = scr->getCookedScroll(top, bottom);
+      if (same && n)
+        gui->scrollImage(n, top, bottom);         // move what is shown already
+      gui->setImage(image,
+                    scr->getLines(),
+                    scr->getColumns(),
+                    same ? scr->getCookedDirty() : 0); // actual refresh
+      //FIXME: check that we do not trigger other draw event here.
+      gui->setLineWrapped( scr->getCookedLineWrapped() );
+      m_shownScreen = scr;
+      m_shownGeneration = scr->generation();
+    }
     gui->setCursorPos(scr->getCursorX(), scr->getCursorY());	// set XIM position
-    free(image);
-    //FIXME: check that we do not trigger other draw event here.
-    gui->setLineWrapped( scr->getCookedLineWrapped() );
     //kdDebug(1211)<<"TEmulation::showBulk(): setScroll()"<<endl;
     gui->setScroll(scr->getHistCursor(),scr->getHistLines());
     //kdDebug(1211)<<"TEmulation::showBulk(): setScroll() done"<<endl;
@@ -480,9 +632,53 @@ void TEmulation::showBulk()
 
 void TEmulation::bulkStart()
 {
-   bulk_timer1.start(BULK_TIMEOUT1,true);
-   if (!bulk_timer2.isActive())
-      bulk_timer2.start(BULK_TIMEOUT2, true);
+  if (m_frameTimer.isActive())
+    return; // the pending frame will show this too
+
+  unsigned long long since = now() - m_lastFrame;
+  unsigned long long budget = m_frameBudget * 1000ULL;
+  m_frameTimer.start(since >= budget ? 0 : (budget - since + 999) / 1000, true);
+}
+
+void TEmulation::showFrame()
+{
+  if (m_parseUsecs >= m_frameBudget * 1000ULL && m_skippedRun < MAX_SKIPPED_FRAMES)
+  {
+    // Drawing now would only hold up the data still to come.
+    m_skippedRun++;
+    m_skippedFrames++;
+    m_parseUsecs = 0;
+    m_frameTimer.start(m_frameBudget, true);
+    return;
+  }
+  showBulk();
+}
+
+/*!
+    sets the time in milliseconds between two refreshes under continuous
+    output, which limits the frame rate.
+*/
+
+void TEmulation::setFrameBudget(int msec)
+{
+  m_frameBudget = QMAX(1, msec);
+}
+
+/*!
+    returns the frames shown per second since the last call, or since a
+    second ago if that was sooner.
+*/
+
+double TEmulation::framesPerSecond()
+{
+  unsigned long long t = now();
+  if (t - m_fpsStart >= 1000000)
+  {
+    m_fps = m_fpsStart ? m_fpsFrames * 1000000.0 / (t - m_fpsStart) : 0;
+    m_fpsFrames = 0;
+    m_fpsStart = t;
+  }
+  return m_fps;
 }
 
 void TEmulation::setConnect(bool c)
@@ -491,6 +687,7 @@ void TEmulation::setConnect(bool c)
   connected = c;
   if ( connected)
   {
+    m_shownScreen = 0; // the widget may have shown something else since
     showBulk();
   }
 }
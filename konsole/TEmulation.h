@@ -27,8 +27,11 @@
 #include <stdio.h>
 #include <qtextcodec.h>
 #include <qguardedptr.h>
+#include <qmemarray.h>
 #include <keytrans.h>
 
+#include "TEUtf8Decoder.h"
+
 enum { NOTIFYNORMAL=0, NOTIFYBELL=1, NOTIFYACTIVITY=2, NOTIFYSILENCE=3 };
 
 class TEmulation : public QObject
@@ -85,6 +88,18 @@ signals:
 public:
 
   virtual void onRcvChar(int);
+  virtual void onRcvPrintable(const char *s, int len);
+  virtual void onRcvText(const unsigned short *s, int len);
+
+  /*! switches to the escape sequence parser the emulation replaced, if any */
+  virtual void setLegacyParser(bool) {}
+  virtual bool legacyParser() const { return false; }
+
+  void setFrameBudget(int msec);
+  int frameBudget() const { return m_frameBudget; }
+  double framesPerSecond();
+  unsigned long framesShown() const { return m_frames; }
+  unsigned long skippedFrames() const { return m_skippedFrames; }
 
   virtual void setMode  (int) = 0;
   virtual void resetMode(int) = 0;
@@ -123,6 +138,14 @@ protected:
 
   const QTextCodec* m_codec;
   QTextDecoder* decoder;
+  bool m_inSequence; // the decoder may hold part of a character
+
+  // UTF-8 is decoded without Qt
+  void onRcvUtf8(const char *s, int len);
+  void onRcvLocale(const char *s, int len);
+  bool m_isUtf8;
+  TEUtf8Decoder m_utf8;
+  QMemArray<unsigned short> m_ucs;
 
   KeyTrans* keytrans;
 
@@ -131,8 +154,10 @@ protected:
 private slots: // triggered by timer
 
   void showBulk();
+  void showFrame();
 
 private:
+  friend class TEReplay; // benchmark times showBulk() on its own
 
   void connectGUI();
 
@@ -140,8 +165,19 @@ private:
 
 private:
 
-  QTimer bulk_timer1;
-  QTimer bulk_timer2;
+  QTimer m_frameTimer;
+  int m_frameBudget;                 // milliseconds between frames
+  unsigned long long m_lastFrame;    // when the last frame was shown
+  unsigned long long m_parseUsecs;   // spent interpreting since then
+  int m_skippedRun;                  // frames skipped in a row
+  unsigned long m_frames;
+  unsigned long m_skippedFrames;
+  unsigned long m_fpsFrames;         // frames since m_fpsStart
+  unsigned long long m_fpsStart;
+  double m_fps;
+
+  TEScreen* m_shownScreen;           // screen the widget was last given
+  unsigned long m_shownGeneration;   // and its generation then
   
   int    m_findPos;
 };
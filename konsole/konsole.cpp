@@ -119,6 +119,7 @@ Time to start a requirement list.
 #include <kshell.h>
 #include <qlabel.h>
 #include <kpopupmenu.h>
+#include <kpassivepopup.h>
 #include <klocale.h>
 #include <sys/wait.h>
 #include <sys/stat.h>
@@ -140,6 +141,8 @@ Time to start a requirement list.
 #include "konsole.h"
 #include <netwm.h>
 #include "printsettings.h"
+#include "TELoopback.h"
+#include "sessioninfo_dialog.h"
 
 #define KONSOLEDEBUG    kdDebug(1211)
 
@@ -213,6 +216,8 @@ SerielleKonsole::SerielleKonsole(const char* name, int histon, bool menubaron, b
 ,masterMode(0)
 ,showMenubar(0)
 ,m_fullscreen(0)
+,m_captureRaw(0)
+,m_shareSession(0)
 ,selectSize(0)
 ,selectFont(0)
 ,selectScrollbar(0)
@@ -477,6 +482,10 @@ void SerielleKonsole::makeGUI()
 
    m_edit->insertSeparator();
    m_sendBreak->plug(m_edit);
+   m_detectSpeed->plug(m_edit);
+   m_captureRaw->plug(m_edit);
+   m_shareSession->plug(m_edit);
+   m_sessionStatistics->plug(m_edit);
 
    m_clearTerminal->plug(m_edit);
 
@@ -974,6 +983,16 @@ void SerielleKonsole::makeBasicGUI()
 
   m_sendBreak = new KAction(i18n("Send &Break"), 0, this,
 			    SLOT(sendBreak()), m_shortcuts, "send_break");
+  m_detectSpeed = new KAction(i18n("&Detect Line Speed"), 0, this,
+                              SLOT(slotDetectSpeed()), m_shortcuts, "detect_speed");
+  m_captureRaw = new KToggleAction(i18n("Capture &Raw Data..."), "filesave", 0, this,
+                                   SLOT(slotToggleCapture()), m_shortcuts, "capture_raw");
+  m_captureRaw->setCheckedState( KGuiItem( i18n( "Stop &Raw Capture" ) ) );
+  m_shareSession = new KToggleAction(i18n("S&hare Session"), 0, this,
+                                     SLOT(slotToggleShare()), m_shortcuts, "share_session");
+  m_shareSession->setCheckedState( KGuiItem( i18n( "Stop S&haring" ) ) );
+  m_sessionStatistics = new KAction(i18n("Session &Statistics..."), "info", 0, this,
+                                    SLOT(slotSessionStatistics()), m_shortcuts, "session_statistics");
   m_clearTerminal = new KAction(i18n("C&lear Terminal"), 0, this,
                                 SLOT(slotClearTerminal()), m_shortcuts, "clear_terminal");
   m_resetClearTerminal = new KAction(i18n("&Reset && Clear Terminal"), 0, this,
@@ -2240,6 +2259,38 @@ void SerielleKonsole::sendBreak()
   if (se) se->sendBreak();
 }
 
+bool SerielleKonsole::replayCapture(const QString &file, double speed)
+{
+  return se && se->replayCapture(file, speed);
+}
+
+/*!
+    Opens a session on a simulated device producing \a pattern traffic
+    at \a rate bytes per second, see TELoopback. Returns the session id,
+    or an empty string if the pty could not be created.
+*/
+QString SerielleKonsole::newLoopbackSession(const QString &pattern, int rate, bool echo)
+{
+  TETrafficGenerator::Pattern p;
+  if (!TETrafficGenerator::patternFromName(pattern, &p)) {
+    kdWarning() << "Unknown traffic pattern " << pattern << endl;
+    return QString::null;
+  }
+
+  TELoopback *loopback = new TELoopback(p, rate, echo);
+  if (!loopback->isOpen()) {
+    delete loopback;
+    return QString::null;
+  }
+
+  QString id = newSession(0, loopback->slaveName(), "konsole",
+                          i18n("Loopback (%1)").arg(pattern));
+  se->insertChild(loopback); // goes away with the session
+  se->setLoopback(loopback);
+  loopback->attach(se->transport());
+  return id;
+}
+
 void SerielleKonsole::runSession(TESession* s)
 {
     KRadioAction *ra = session2action.find(s);
@@ -2446,6 +2497,8 @@ void SerielleKonsole::activateSession(TESession *s)
   if (m_findPrevious) m_findPrevious->setEnabled( se->history().isOn() );
   se->getEmulation()->findTextBegin();
   if (m_saveHistory) m_saveHistory->setEnabled( se->history().isOn() );
+  if (m_captureRaw) m_captureRaw->setChecked( se->isCapturing() );
+  if (m_shareSession) m_shareSession->setChecked( !se->sharePath().isEmpty() );
   if (monitorActivity) monitorActivity->setChecked( se->isMonitorActivity() );
   if (monitorSilence) monitorSilence->setChecked( se->isMonitorSilence() );
   masterMode->setChecked( se->isMasterMode() );
@@ -2640,11 +2693,27 @@ QString SerielleKonsole::newSession(KSimpleConfig *co, const QString &_device,
   QString sch = s_kconfigSchema;
   QString txt;
   QFont font = defaultFont;
-  TETty::FlowControl flow = TETty::fcNone;
+  TETransport::FlowControl flow = TETransport::fcNone;
   int speed = 115200;
-  TETty::Parity parity = TETty::parNone;
+  TETransport::Parity parity = TETransport::parNone;
   int bits = 8;
   int stopbits = 1;
+  int readBatchLimit = 64*1024;
+  // Lines are serviced by the shared I/O thread unless the session
+  // says IOThread=false or there are no threads to be had.
+#ifdef QT_THREAD_SUPPORT
+  bool ioThread = true;
+#else
+  bool ioThread = false;
+#endif
+  TETransport::LatencyProfile latency = TETransport::lpInteractive;
+  int readCoalesce = -1;
+  bool autoBaud = false;
+  bool legacyParser = false;
+  int frameBudget = 0;
+  bool shareSession = false;
+  QString shareSocket;
+  TEShareServer::Policy sharePolicy = TEShareServer::DropData;
 
   if (co) {
      co->setDesktopGroup();
@@ -2654,11 +2723,23 @@ QString SerielleKonsole::newSession(KSimpleConfig *co, const QString &_device,
      txt = co->readEntry("Name");
      font = co->readFontEntry("SessionFont", &font);
      icon = co->readEntry("Icon", icon);
-     flow = TETty::FlowControl(co->readNumEntry("FlowControl", flow));
+     flow = TETransport::FlowControl(co->readNumEntry("FlowControl", flow));
      speed = co->readNumEntry("Speed", speed);
-     parity = TETty::Parity(co->readNumEntry("Parity", parity));
+     parity = TETransport::Parity(co->readNumEntry("Parity", parity));
      bits = co->readNumEntry("Bits", parity);
      stopbits = co->readNumEntry("StopBits", parity);
+     readBatchLimit = co->readNumEntry("ReadBatchLimit", readBatchLimit);
+     ioThread = co->readBoolEntry("IOThread", ioThread);
+     if (co->readEntry("LatencyProfile").lower() == "throughput")
+       latency = TETransport::lpThroughput;
+     readCoalesce = co->readNumEntry("ReadCoalesce", readCoalesce);
+     autoBaud = co->readBoolEntry("AutoBaud", autoBaud);
+     legacyParser = co->readBoolEntry("LegacyParser", legacyParser);
+     frameBudget = co->readNumEntry("FrameBudget", frameBudget);
+     shareSession = co->readBoolEntry("Share", shareSession);
+     shareSocket = co->readPathEntry("ShareSocket");
+     if (co->readEntry("SharePolicy").lower() == "block")
+       sharePolicy = TEShareServer::BlockClient;
   }
 
   if (!_device.isEmpty())
@@ -2720,6 +2801,8 @@ QString SerielleKonsole::newSession(KSimpleConfig *co, const QString &_device,
            this, SLOT(notifySize(int,int)));
   connect( s, SIGNAL(zmodemDetected(TESession*)),
            this, SLOT(slotZModemDetected(TESession*)));
+  connect( s, SIGNAL(speedDetected(TESession*, int)),
+           this, SLOT(slotSpeedDetected(TESession*, int)));
   connect( s, SIGNAL(updateSessionConfig(TESession*)),
            this, SLOT(slotUpdateSessionConfig(TESession*)));
   connect( s, SIGNAL(resizeSession(TESession*, QSize)),
@@ -2744,6 +2827,10 @@ QString SerielleKonsole::newSession(KSimpleConfig *co, const QString &_device,
     s->setKeymap(key);
   }
 
+  // Name the device of a pty pair, that is what the other end opens.
+  QString peer = s->transport()->peerName();
+  if ( !peer.isEmpty() )
+    txt = i18n("%1 (%2)").arg(txt).arg(peer);
   s->setTitle(txt);
   s->setIconName(icon);
   s->setFlowControl(flow);
@@ -2751,6 +2838,22 @@ QString SerielleKonsole::newSession(KSimpleConfig *co, const QString &_device,
   s->setParity(parity);
   s->setBits(bits);
   s->setStopBits(stopbits);
+  s->setReadBatchLimit(readBatchLimit);
+  s->setThreaded(ioThread);
+  s->setLatencyProfile(latency);
+  if (readCoalesce >= 0)
+    s->setReadCoalesce(readCoalesce);
+  // Speed is where the probe starts from and what is kept if nothing
+  // can be detected.
+  if (autoBaud)
+    s->detectSpeed();
+  if (legacyParser)
+    s->getEmulation()->setLegacyParser(true);
+  if (frameBudget > 0)
+    s->getEmulation()->setFrameBudget(frameBudget);
+  s->setSharePolicy(sharePolicy);
+  if (shareSession && !s->startSharing(shareSocket))
+    kdWarning() << "Cannot share session: " << s->shareError() << endl;
 
   if (b_histEnabled && m_histSize)
     s->setHistory(HistoryTypeBuffer(m_histSize));
@@ -3832,6 +3935,50 @@ void SerielleKonsole::slotSaveHistory()
   }
 }
 
+void SerielleKonsole::slotToggleCapture()
+{
+  if (!se) return;
+
+  if (!m_captureRaw->isChecked()) {
+    se->stopCapture();
+    return;
+  }
+
+  QString file = KFileDialog::getSaveFileName(QString::null, "*.skcap", this,
+                                              i18n("Capture Raw Data"));
+  if (file.isEmpty() || !se->startCapture(file)) {
+    if (!file.isEmpty())
+      KMessageBox::sorry(this, i18n("Unable to write to file."));
+    m_captureRaw->setChecked(false);
+  }
+}
+
+void SerielleKonsole::slotToggleShare()
+{
+  if (!se) return;
+
+  if (!m_shareSession->isChecked()) {
+    se->stopSharing();
+    return;
+  }
+
+  if (se->startSharing(QString::null))
+    KPassivePopup::message(se->Title(),
+                           i18n("Other programs can attach to this session at %1.").arg(se->sharePath()), this);
+  else {
+    KMessageBox::detailedError(this, i18n("Unable to share the session."), se->shareError());
+    m_shareSession->setChecked(false);
+  }
+}
+
+void SerielleKonsole::slotSessionStatistics()
+{
+  if (!se) return;
+
+  SessionInfoDialog *dlg = new SessionInfoDialog(this, se);
+  dlg->show();
+}
+
 void SerielleKonsole::slotZModemUpload()
 {
   if (se->zmodemIsBusy())
@@ -3860,6 +4007,25 @@ void SerielleKonsole::slotZModemUpload()
   se->startZModem(zmodem, QString::null, files);
 }
 
+void SerielleKonsole::slotDetectSpeed()
+{
+  if (!se) return;
+
+  if (!se->detectSpeed())
+    KMessageBox::sorry(this, i18n("The speed of this line cannot be detected."));
+}
+
+void SerielleKonsole::slotSpeedDetected(TESession *session, int speed)
+{
+  if (speed)
+    KPassivePopup::message(session->Title(),
+                           i18n("Line speed set to %1 baud.").arg(speed), this);
+  else
+    KPassivePopup::message(session->Title(),
+                           i18n("Could not detect the line speed. Either the device sent nothing "
+                                "or it does not send text."), this);
+}
+
 void SerielleKonsole::slotZModemDetected(TESession *session)
 {
   if (!kapp->authorize("zmodem_download")) return;
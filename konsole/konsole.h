@@ -82,6 +82,8 @@ public:
   void initMasterMode(bool on);
   void initTabColor(QColor color);
   void initHistory(int lines, bool enable);
+  bool replayCapture(const QString &file, double speed);
+  QString newLoopbackSession(const QString &pattern, int rate, bool echo);
   void newSession(const QString &device, const QString &icon, const QString &title);
   void setSchema(const QString & path);
   void setEncoding(int);
@@ -181,6 +183,10 @@ private slots:
   void slotClearHistory();
   void slotFindHistory();
   void slotSaveHistory();
+  void slotToggleCapture();
+  void slotToggleShare();
+  void slotSessionStatistics();
+  void slotDetectSpeed();
   void slotSelectBell();
   void slotSelectSize();
   void slotSelectFont();
@@ -218,6 +224,7 @@ private slots:
   void smallerFont();
 
   void slotZModemDetected(TESession *session);
+  void slotSpeedDetected(TESession *session, int speed);
   void slotZModemUpload();
 
   void slotPrint();
@@ -317,6 +324,8 @@ private:
   KToggleAction *masterMode, *m_tabMasterMode;
   KToggleAction *showMenubar;
   KToggleAction *m_fullscreen;
+  KToggleAction *m_captureRaw;
+  KToggleAction *m_shareSession;
 
   KSelectAction *selectSize;
   KSelectAction *selectFont;
@@ -338,6 +347,8 @@ private:
   KAction       *m_pasteClipboard;
   KAction       *m_pasteSelection;
   KAction       *m_sendBreak;
+  KAction       *m_sessionStatistics;
+  KAction       *m_detectSpeed;
   KAction       *m_clearTerminal;
   KAction       *m_resetClearTerminal;
   KAction       *m_clearAllSessionHistories;
@@ -0,0 +1,71 @@
+/*
+    This file is part of Konsole, an X terminal.
+    Copyright (C) 2007 Diego Pettenò <flameeyes@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+#include "konsole_baud.h"
+
+#if defined(__linux__)
+# include <asm/termbits.h>
+# include <sys/ioctl.h>
+#endif
+
+#if defined(__linux__) && defined(TCGETS2) && defined(BOTHER)
+
+int konsole_set_custom_baud(int fd, int speed)
+{
+  struct termios2 tio;
+
+  if (speed <= 0 || ioctl(fd, TCGETS2, &tio) < 0)
+    return -1;
+
+  tio.c_cflag &= ~CBAUD;
+  tio.c_cflag |= BOTHER;
+  tio.c_ospeed = speed;
+#ifdef CIBAUD
+  tio.c_cflag &= ~CIBAUD;
+  tio.c_cflag |= BOTHER << IBSHIFT;
+#endif
+  tio.c_ispeed = speed;
+
+  return ioctl(fd, TCSETS2, &tio) < 0 ? -1 : 0;
+}
+
+int konsole_get_baud(int fd)
+{
+  struct termios2 tio;
+
+  if (ioctl(fd, TCGETS2, &tio) < 0)
+    return -1;
+
+  return tio.c_ospeed;
+}
+
+#else
+
+int konsole_set_custom_baud(int, int)
+{
+  return -1;
+}
+
+int konsole_get_baud(int)
+{
+  return -1;
+}
+
+#endif
@@ -0,0 +1,36 @@
+/*
+    This file is part of Konsole, an X terminal.
+    Copyright (C) 2007 Diego Pettenò <flameeyes@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+#ifndef _KONSOLE_BAUD_H_
+#define _KONSOLE_BAUD_H_
+
+/*
+   Access to arbitrary line speeds. On Linux this goes through the
+   termios2 interface (BOTHER), which cannot be used in the same
+   translation unit as the libc <termios.h>, hence the separate file.
+*/
+
+/* sets both line speeds of fd to speed bits/s; returns 0 on success */
+int konsole_set_custom_baud(int fd, int speed);
+
+/* returns the output speed the driver reports for fd, or -1 if unknown */
+int konsole_get_baud(int fd);
+
+#endif
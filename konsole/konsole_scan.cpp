@@ -0,0 +1,217 @@
+/*
+    This file is part of Konsole, an X terminal.
+    Copyright (C) 2007 Diego Pettenò <flameeyes@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+#include "konsole_scan.h"
+
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__)))
+# define SCAN_SSE2 1
+# include <emmintrin.h>
+# if __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)
+#  define SCAN_AVX2 1
+#  include <immintrin.h>
+# endif
+#endif
+
+typedef unsigned long scan_word;
+
+#define ONES  ((scan_word)~0UL / 0xff)
+#define HIGHS (ONES * 0x80)
+
+/*
+   A word holds a special byte if one is below 0x20 (the subtraction
+   borrows) or one is 0x7f or above (adding one sets the high bit). A
+   borrow or carry only spills over from a byte that is special itself,
+   so a word without special bytes is never flagged.
+*/
+static inline bool special_word(scan_word x)
+{
+  return (((x - ONES * 0x20) & ~x) | ((x + ONES) | x)) & HIGHS;
+}
+
+static inline bool printable(unsigned char c)
+{
+  return c >= 0x20 && c < 0x7f;
+}
+
+int konsole_ascii_run_scalar(const char *s, int len)
+{
+  int i = 0;
+  for ( ; i + (int)sizeof(scan_word) <= len; i += sizeof(scan_word) )
+  {
+    scan_word x;
+    memcpy(&x, s + i, sizeof(x));
+    if ( x & HIGHS )
+      break;
+  }
+  while ( i < len && !(s[i] & 0x80) )
+    i++;
+  return i;
+}
+
+int konsole_printable_run_scalar(const char *s, int len)
+{
+  int i = 0;
+  for ( ; i + (int)sizeof(scan_word) <= len; i += sizeof(scan_word) )
+  {
+    scan_word x;
+    memcpy(&x, s + i, sizeof(x));
+    if ( special_word(x) )
+      break;
+  }
+  while ( i < len && printable(s[i]) )
+    i++;
+  return i;
+}
+
+#ifdef SCAN_SSE2
+/*
+   Bytes of 0x80 and above are negative as signed chars, so a signed
+   "greater than 0x1f" leaves exactly 0x20-0x7f; DEL is taken out with
+   a compare of its own.
+*/
+static int printable_run_sse2(const char *s, int len)
+{
+  const __m128i space = _mm_set1_epi8(0x1f);
+  const __m128i del = _mm_set1_epi8(0x7f);
+
+  int i = 0;
+  for ( ; i + 16 <= len; i += 16 )
+  {
+    __m128i x = _mm_loadu_si128((const __m128i*)(s + i));
+    __m128i ok = _mm_andnot_si128(_mm_cmpeq_epi8(x, del), _mm_cmpgt_epi8(x, space));
+    unsigned mask = _mm_movemask_epi8(ok);
+    if ( mask != 0xffff )
+      return i + __builtin_ctz(~mask);
+  }
+  return i + konsole_printable_run_scalar(s + i, len - i);
+}
+
+static int ascii_run_sse2(const char *s, int len)
+{
+  int i = 0;
+  for ( ; i + 16 <= len; i += 16 )
+  {
+    unsigned mask = _mm_movemask_epi8(_mm_loadu_si128((const __m128i*)(s + i)));
+    if ( mask )
+      return i + __builtin_ctz(mask);
+  }
+  return i + konsole_ascii_run_scalar(s + i, len - i);
+}
+#endif
+
+#ifdef SCAN_AVX2
+__attribute__((target("avx2")))
+static int printable_run_avx2(const char *s, int len)
+{
+  const __m256i space = _mm256_set1_epi8(0x1f);
+  const __m256i del = _mm256_set1_epi8(0x7f);
+
+  int i = 0;
+  for ( ; i + 32 <= len; i += 32 )
+  {
+    __m256i x = _mm256_loadu_si256((const __m256i*)(s + i));
+    __m256i ok = _mm256_andnot_si256(_mm256_cmpeq_epi8(x, del), _mm256_cmpgt_epi8(x, space));
+    unsigned mask = _mm256_movemask_epi8(ok);
+    if ( mask != 0xffffffffU )
+      return i + __builtin_ctz(~mask);
+  }
+  return i + printable_run_sse2(s + i, len - i);
+}
+
+__attribute__((target("avx2")))
+static int ascii_run_avx2(const char *s, int len)
+{
+  int i = 0;
+  for ( ; i + 32 <= len; i += 32 )
+  {
+    unsigned mask = _mm256_movemask_epi8(_mm256_loadu_si256((const __m256i*)(s + i)));
+    if ( mask )
+      return i + __builtin_ctz(mask);
+  }
+  return i + ascii_run_sse2(s + i, len - i);
+}
+#endif
+
+static int printable_run_first(const char *s, int len);
+static int ascii_run_first(const char *s, int len);
+
+static int (*printable_run)(const char *, int) = printable_run_first;
+static int (*ascii_run)(const char *, int) = ascii_run_first;
+
+// Picks the implementations on the first call.
+static void pick()
+{
+#if defined(SCAN_AVX2)
+  __builtin_cpu_init();
+  if ( __builtin_cpu_supports("avx2") )
+  {
+    printable_run = printable_run_avx2;
+    ascii_run = ascii_run_avx2;
+    return;
+  }
+#endif
+#if defined(SCAN_SSE2)
+  printable_run = printable_run_sse2;
+  ascii_run = ascii_run_sse2;
+#else
+  printable_run = konsole_printable_run_scalar;
+  ascii_run = konsole_ascii_run_scalar;
+#endif
+}
+
+static int printable_run_first(const char *s, int len)
+{
+  pick();
+  return printable_run(s, len);
+}
+
+static int ascii_run_first(const char *s, int len)
+{
+  pick();
+  return ascii_run(s, len);
+}
+
+int konsole_printable_run(const char *s, int len)
+{
+  // Most runs between escape sequences are short; the vector setup is
+  // not worth it for those.
+  if ( len < 16 )
+  {
+    int i = 0;
+    while ( i < len && printable(s[i]) )
+      i++;
+    return i;
+  }
+  return printable_run(s, len);
+}
+
+int konsole_ascii_run(const char *s, int len)
+{
+  if ( len < 16 )
+  {
+    int i = 0;
+    while ( i < len && !(s[i] & 0x80) )
+      i++;
+    return i;
+  }
+  return ascii_run(s, len);
+}
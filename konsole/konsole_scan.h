@@ -0,0 +1,41 @@
+/*
+    This file is part of Konsole, an X terminal.
+    Copyright (C) 2007 Diego Pettenò <flameeyes@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+#ifndef _KONSOLE_SCAN_H_
+#define _KONSOLE_SCAN_H_
+
+/*
+   Finding the bytes the emulation has to look at one by one: control
+   codes (ESC included), DEL and anything with the high bit set, or
+   only the latter for the UTF-8 decoder. The scans use AVX2 or SSE2
+   where the processor has them, and a word at a time otherwise.
+*/
+
+/* returns the number of printable ASCII bytes (0x20-0x7e) s starts with */
+int konsole_printable_run(const char *s, int len);
+
+/* returns the number of ASCII bytes (below 0x80) s starts with */
+int konsole_ascii_run(const char *s, int len);
+
+/* the same, without the vector paths; scanbench checks the others against them */
+int konsole_printable_run_scalar(const char *s, int len);
+int konsole_ascii_run_scalar(const char *s, int len);
+
+#endif
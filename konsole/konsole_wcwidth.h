@@ -9,10 +9,15 @@
 #include <qglobal.h>
 #include <qstring.h>
 
-int konsole_wcwidth(Q_UINT16 ucs);
-#if 0
-int konsole_wcwidth_cjk(Q_UINT16 ucs);
-#endif
+/* generated by wcwidthgen, in konsole_wcwidth_table.h */
+extern const unsigned char konsole_wcwidth_pages[256];
+extern const signed char konsole_wcwidth_blocks[][256];
+
+/* column width of ucs: -1 for controls, 0, 1 or 2 */
+inline int konsole_wcwidth(Q_UINT16 ucs)
+{
+  return konsole_wcwidth_blocks[konsole_wcwidth_pages[ucs >> 8]][ucs & 0xff];
+}
 
 int string_width( const QString &txt );
 
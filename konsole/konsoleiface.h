@@ -33,6 +33,7 @@ class KonsoleIface : virtual public DCOPObject
     virtual QString currentSession() = 0;
     virtual QString newSession() = 0;
     virtual QString newSession(const QString &type) = 0;
+    virtual QString newLoopbackSession(const QString &pattern, int rate, bool echo) = 0;
     virtual QString sessionId(const int position) = 0;
 
     virtual void activateSession(const QString &sessionId) = 0;
@@ -29,6 +29,7 @@
 #include <qdir.h>
 #include <qsessionmanager.h>
 #include <qwidgetlist.h>
+#include <qtextcodec.h>
 
 #include <dcopclient.h>
 
@@ -45,6 +46,7 @@
 #include <config.h>
 
 #include "konsole.h"
+#include "TEReplay.h"
 
 // COMPOSITE disabled by default because the QApplication constructor
 // needed to enable the ARGB32 visual has undesired side effects.
@@ -90,6 +92,12 @@ static KCmdLineOptions options[] =
    { "schemas",         0, 0 },
    { "schemata",        I18N_NOOP("List available schemata"), 0 },
    { "script",          I18N_NOOP("Enable extended DCOP Qt functions"), 0 },
+   { "replay <file>",   I18N_NOOP("Replay a raw capture or byte dump into the session"), 0 },
+   { "replay-speed <factor>", I18N_NOOP("Replay speed relative to the recording, 0 for as fast as possible"), "1" },
+   { "benchmark",       I18N_NOOP("Measure the emulation throughput on the replay file and exit"), 0 },
+   { "loopback <pattern>", I18N_NOOP("Open a session on a simulated device sending ascii, ansi, utf8 or binary traffic"), 0 },
+   { "loopback-rate <bytes>", I18N_NOOP("Traffic rate of the simulated device in bytes per second, 0 for no limit"), "0" },
+   { "loopback-echo",   I18N_NOOP("Have the session send the traffic and the simulated device echo it"), 0 },
    KCmdLineLastOption
 };
 
@@ -289,6 +297,18 @@ extern "C" int KDE_EXPORT kdemain(int argc, char* argv[])
   full_script = args->isSet("script");
   fixed_size = !args->isSet("resize");
 
+  QString replay;
+  if (args->isSet("replay"))
+    replay = QFile::decodeName(args->getOption("replay"));
+  double replaySpeed = QString(args->getOption("replay-speed")).toDouble();
+  bool benchmark = args->isSet("benchmark");
+
+  QString loopback;
+  if (args->isSet("loopback"))
+    loopback = args->getOption("loopback");
+  int loopbackRate = QString(args->getOption("loopback-rate")).toInt();
+  bool loopbackEcho = args->isSet("loopback-echo");
+
   if (!full_script)
 	a.dcopClient()->setQtBridgeEnabled(false);
 
@@ -397,6 +417,15 @@ extern "C" int KDE_EXPORT kdemain(int argc, char* argv[])
 
   // ///////////////////////////////////////////////
 
+  // The benchmark needs neither a window nor a line.
+  if (!replay.isEmpty() && benchmark) {
+    QString report = TEReplay::benchmark(replay, QTextCodec::codecForLocale(), false,
+                                         QSize(c ? c : 80, l ? l : 24),
+                                         KGlobalSettings::fixedFont());
+    printf("%s", report.local8Bit().data());
+    return report.isEmpty() ? 1 : 0;
+  }
+
   KonsoleSessionManaged ksm;
 
   if (a.isRestored() || !profile.isEmpty())
@@ -532,7 +561,12 @@ extern "C" int KDE_EXPORT kdemain(int argc, char* argv[])
 
     m->initFullScreen();
     m->show();
-    if (showtip)
+
+    if (!loopback.isEmpty())
+      m->newLoopbackSession(loopback, loopbackRate, loopbackEcho);
+    if (!replay.isEmpty())
+      m->replayCapture(replay, replaySpeed);
+    else if (showtip)
       m->showTipOnStart();
   }
 
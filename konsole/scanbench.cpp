@@ -0,0 +1,197 @@
+/*
+    This file is part of Konsole, an X terminal.
+    Copyright (C) 2007 Diego Pettenò <flameeyes@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+/*
+ * Checks the vector scans of konsole_scan.cpp against the word at a time
+ * ones and a plain loop, at every alignment, and the UTF-8 decoder on
+ * known input and fed in pieces. Times the scans.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "konsole_scan.h"
+#include "TEUtf8Decoder.h"
+#include "TEClock.h"
+
+#define TRIALS 200000
+#define MAXLEN 300
+#define ROUNDS 2000
+
+static int plain_printable_run(const char *s, int len)
+{
+  int i = 0;
+  while ( i < len && (unsigned char)s[i] >= 0x20 && (unsigned char)s[i] < 0x7f )
+    i++;
+  return i;
+}
+
+static int plain_ascii_run(const char *s, int len)
+{
+  int i = 0;
+  while ( i < len && !(s[i] & 0x80) )
+    i++;
+  return i;
+}
+
+static int checkScans()
+{
+  static char buf[MAXLEN];
+  int errors = 0;
+
+  srand(1);
+  for ( int t = 0; t < TRIALS && errors < 10; t++ )
+  {
+    // Long runs of text with the odd control code or 8 bit byte, so the
+    // runs end anywhere in a vector.
+    int len = rand() % MAXLEN;
+    for ( int i = 0; i < len; i++ )
+      buf[i] = rand() % 20 ? 0x20 + rand() % 95 : rand() % 256;
+
+    for ( int off = 0; off < 32 && off < len; off++ )
+    {
+      const char *s = buf + off;
+      int n = len - off;
+      int want = plain_printable_run(s, n);
+      if ( konsole_printable_run(s, n) != want || konsole_printable_run_scalar(s, n) != want )
+      {
+        if ( errors++ < 10 )
+          fprintf(stderr, "printable run at %d of %d: %d, scalar %d, should be %d\n", off, len,
+                  konsole_printable_run(s, n), konsole_printable_run_scalar(s, n), want);
+      }
+      want = plain_ascii_run(s, n);
+      if ( konsole_ascii_run(s, n) != want || konsole_ascii_run_scalar(s, n) != want )
+      {
+        if ( errors++ < 10 )
+          fprintf(stderr, "ASCII run at %d of %d: %d, scalar %d, should be %d\n", off, len,
+                  konsole_ascii_run(s, n), konsole_ascii_run_scalar(s, n), want);
+      }
+    }
+  }
+  return errors;
+}
+
+/* decodes \a s in pieces of \a piece bytes, flushing at the end */
+static int decodeAll(const char *s, int len, int piece, unsigned short *out)
+{
+  TEUtf8Decoder decoder;
+  int o = 0;
+  for ( int i = 0; i < len; i += piece )
+    o += decoder.decode(s + i, len - i < piece ? len - i : piece, out + o);
+  if ( decoder.flush() )
+    out[o++] = 0xfffd;
+  return o;
+}
+
+struct DecoderCase
+{
+  const char *name;
+  const char *in;
+  unsigned short out[8];
+  int count;
+};
+
+static const DecoderCase decoderCases[] =
+{
+  { "ASCII",         "hello",                 { 'h','e','l','l','o' }, 5 },
+  { "two bytes",     "caf\xc3\xa9!",          { 'c','a','f',0xe9,'!' }, 5 },
+  { "three bytes",   "\xe2\x82\xac x",        { 0x20ac,' ','x' }, 3 },
+  { "four bytes",    "\xf0\x9f\x98\x80" "a",  { 0xfffd,'a' }, 2 },
+  { "cut short",     "\xe2\x82" "a",          { 0xfffd,'a' }, 2 },
+  { "stray",         "\x80\xbf" "a",          { 0xfffd,0xfffd,'a' }, 3 },
+  { "overlong",      "\xe0\x80\xaf" "a",      { 0xfffd,'a' }, 2 },
+  { "surrogate",     "\xed\xa0\x80" "a",      { 0xfffd,'a' }, 2 },
+  { "bad lead byte", "\xc0\xaf" "a",          { 0xfffd,0xfffd,'a' }, 3 },
+  { "unfinished",    "ab\xe2\x82",            { 'a','b',0xfffd }, 3 }
+};
+
+static int checkDecoder()
+{
+  static unsigned short out[MAXLEN+1], split[MAXLEN+1];
+  static char in[MAXLEN];
+  int errors = 0;
+
+  for ( unsigned int c = 0; c < sizeof(decoderCases)/sizeof(decoderCases[0]); c++ )
+  {
+    const DecoderCase &dc = decoderCases[c];
+    int n = decodeAll(dc.in, strlen(dc.in), MAXLEN, out);
+    if ( n != dc.count || memcmp(out, dc.out, n*sizeof(out[0])) )
+    {
+      fprintf(stderr, "decoder, %s:", dc.name);
+      for ( int i = 0; i < n; i++ )
+        fprintf(stderr, " %04x", out[i]);
+      fprintf(stderr, "\n");
+      errors++;
+    }
+  }
+
+  // Whatever the input, where the blocks end must not matter.
+  srand(3);
+  for ( int t = 0; t < TRIALS/10 && errors < 10; t++ )
+  {
+    int len = rand() % 64;
+    for ( int i = 0; i < len; i++ )
+      in[i] = rand() % 4 ? 0x80 + rand() % 64 : rand() % 256;
+    int n = decodeAll(in, len, MAXLEN, out);
+    if ( n > len + 1 )
+    {
+      fprintf(stderr, "decoder made %d characters of %d bytes\n", n, len);
+      errors++;
+    }
+    for ( int piece = 1; piece < 8; piece++ )
+      if ( decodeAll(in, len, piece, split) != n || memcmp(out, split, n*sizeof(out[0])) )
+      {
+        if ( errors++ < 10 )
+          fprintf(stderr, "decoder gives other characters in pieces of %d\n", piece);
+      }
+  }
+  return errors;
+}
+
+static char text[1 << 20];
+
+int main()
+{
+  int errors = checkScans() + checkDecoder();
+  if ( errors )
+  {
+    fprintf(stderr, "%d checks failed\n", errors);
+    return 1;
+  }
+  printf("scans and decoder match\n");
+
+  memset(text, 'a', sizeof(text));
+  int sum = 0;
+  unsigned long long start = now();
+  for ( int r = 0; r < ROUNDS; r++ )
+    sum += konsole_printable_run_scalar(text, sizeof(text));
+  unsigned long long scalar = now() - start;
+
+  start = now();
+  for ( int r = 0; r < ROUNDS; r++ )
+    sum += konsole_printable_run(text, sizeof(text));
+  unsigned long long vector = now() - start;
+
+  double mb = ROUNDS * (sizeof(text) / 1048576.0);
+  printf("scalar %8.1f MB/s\n", mb / (scalar / 1e6));
+  printf("vector %8.1f MB/s\n", mb / (vector / 1e6));
+  return sum == 0;
+}
@@ -0,0 +1,285 @@
+/*
+    This file is part of Konsole, an X terminal.
+    Copyright (C) 2007 Diego Pettenò <flameeyes@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+/*
+ * Drives two screens through the same random operations, one printing
+ * runs with ShowCharacters() and the other one character at a time, and
+ * checks that
+ *
+ *  - both end up the same,
+ *  - the image getCookedImage() updates incrementally is the one it
+ *    would cook from scratch,
+ *  - a widget that applies the reported scroll and repaints the dirty
+ *    lines shows that image, and
+ *  - the image does not change while generation() does not.
+ *
+ * Then times newline floods on screens of growing height. Scrolling
+ * moves line pointers rather than cells, so the time per line should
+ * grow only slowly with the height of the screen.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <qmemarray.h>
+
+#include "TEScreen.h"
+
+#define TRIALS 300
+#define STEPS 3000
+#define FLOOD_LINES 200000
+
+static int failures = 0;
+
+static void fail(int trial, int step, const char *what, int i, int columns)
+{
+  if ( failures++ < 10 )
+    fprintf(stderr, "trial %d, step %d: %s at line %d, column %d\n",
+            trial, step, what, i / columns, i % columns);
+}
+
+/*
+   Cooks the whole image: switching the screen to reverse and back
+   marks every line dirty.
+*/
+static void fullCook(TEScreen &screen, QMemArray<ca> &out)
+{
+  bool reverse = screen.getMode(MODE_Screen);
+  if ( reverse ) screen.resetMode(MODE_Screen); else screen.setMode(MODE_Screen);
+  screen.getCookedImage();
+  if ( reverse ) screen.setMode(MODE_Screen); else screen.resetMode(MODE_Screen);
+
+  int n = screen.getLines() * screen.getColumns();
+  out.resize(n);
+  memcpy(out.data(), screen.getCookedImage(), n * sizeof(ca));
+}
+
+static double now()
+{
+  struct timeval tv;
+  gettimeofday(&tv, 0);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static int differs(const ca *a, const ca *b, int n)
+{
+  for ( int i = 0; i < n; i++ )
+    if ( a[i] != b[i] )
+      return i;
+  return -1;
+}
+
+/* a random run for ShowCharacters(), with wide and combining characters */
+static int randomRun(unsigned short *run)
+{
+  int n = rand() % 100;
+  for ( int i = 0; i < n; i++ )
+  {
+    int r = rand() % 20;
+    run[i] = r == 0 ? 0x4e00 + rand() % 100 : r == 1 ? 0x301 : 0x20 + rand() % 95;
+  }
+  return n;
+}
+
+static void operate(TEScreen &s, int op, int a, int b, int c)
+{
+  int lines = s.getLines(), columns = s.getColumns();
+  switch ( op )
+  {
+    case  0: s.ShowCharacter(0x21 + a % 94);                   break;
+    case  1: s.NewLine();                                       break;
+    case  2: s.index();                                         break;
+    case  3: s.reverseIndex();                                  break;
+    case  4: s.setCursorYX(1 + a % lines, 1 + b % columns);     break;
+    case  5: s.clearToEndOfScreen();                            break;
+    case  6: s.clearToBeginOfLine();                            break;
+    case  7: s.insertLines(1 + a % 3);                          break;
+    case  8: s.deleteLines(1 + a % 3);                          break;
+    case  9: s.insertChars(1 + a % 5);                          break;
+    case 10: s.deleteChars(1 + a % 5);                          break;
+    case 11: s.setMargins(1 + a % lines, 1 + b % lines);        break;
+    case 12: if ( c % 2 ) s.scrollUp(1 + a % 3); else s.scrollDown(1 + a % 3); break;
+    case 13: {
+      int mode = a % 3 == 0 ? MODE_Screen : a % 3 == 1 ? MODE_Cursor : MODE_Insert;
+      if ( c % 2 ) s.setMode(mode); else s.resetMode(mode);
+      break;
+    }
+    case 14: s.setSelBeginXY(a % columns, b % lines, c % 4 == 0); break;
+    case 15: s.setSelExtentXY(a % columns, b % lines);          break;
+    case 16: if ( c % 4 == 0 ) s.clearSelection();              break;
+    case 17: s.setHistCursor(a % (s.getHistLines() + 1));       break;
+    case 18: if ( c % 40 == 0 ) s.resizeImage(5 + a % 25, 10 + b % 70); break;
+    case 19: s.BackSpace();                                     break;
+    case 20: s.setRendition(RE_BLINK); s.setForeColor(CO_SYS, a % 8); break;
+    case 21: s.eraseChars(1 + a % 4); s.Tabulate();             break;
+    case 22: s.setHistCursor(s.getHistLines()); s.clearEntireLine(); break;
+  }
+}
+
+int main()
+{
+  long checks = 0, scrolls = 0;
+  QMemArray<ca> full, other, shown, last;
+  unsigned short run[100];
+
+  for ( int trial = 0; trial < TRIALS && !failures; trial++ )
+  {
+    srand(trial);
+    int lines = 10 + rand() % 20, columns = 20 + rand() % 60;
+    TEScreen screen(lines, columns);   // prints runs
+    TEScreen single(lines, columns);   // prints one character at a time
+    if ( rand() % 2 )
+    {
+      HistoryTypeBuffer history(5 + rand() % 50);
+      screen.setScroll(history);
+      single.setScroll(history);
+    }
+
+    unsigned long lastGeneration = 0;
+    bool haveShown = false;
+    for ( int step = 0; step < STEPS && !failures; step++ )
+    {
+      int op = rand() % 26;
+      if ( op >= 23 )
+      {
+        int n = randomRun(run);
+        screen.ShowCharacters(run, n);
+        for ( int i = 0; i < n; i++ )
+          single.ShowCharacter(run[i]);
+      }
+      else
+      {
+        int a = rand(), b = rand(), c = rand();
+        operate(screen, op, a, b, c);
+        operate(single, op, a, b, c);
+      }
+
+      if ( rand() % 3 )
+        continue;
+
+      int n = screen.getLines() * screen.getColumns();
+      int columns = screen.getColumns();
+      unsigned long generation = screen.generation();
+      if ( haveShown && generation == lastGeneration && (int)shown.size() == n )
+      {
+        int i = differs(screen.getCookedImage(), shown.data(), n);
+        if ( i >= 0 )
+          fail(trial, step, "image changed without a new generation", i, columns);
+        continue;
+      }
+
+      const ca *cooked = screen.getCookedImage();
+      if ( !haveShown || (int)shown.size() != n )
+      {
+        shown.resize(n);
+        memcpy(shown.data(), cooked, n * sizeof(ca));
+      }
+      else
+      {
+        // what the widget makes of the image it showed before
+        int top, bottom;
+        int count = screen.getCookedScroll(top, bottom);
+        const char *dirty = screen.getCookedDirty();
+        if ( count )
+        {
+          scrolls++;
+          last.resize(n);
+          memcpy(last.data(), shown.data(), n * sizeof(ca));
+          for ( int y = top; y <= bottom; y++ )
+            if ( y + count >= top && y + count <= bottom )
+              memcpy(shown.data() + y*columns, last.data() + (y+count)*columns,
+                     columns * sizeof(ca));
+        }
+        for ( int y = 0; y < screen.getLines(); y++ )
+          if ( dirty[y] )
+            memcpy(shown.data() + y*columns, cooked + y*columns, columns * sizeof(ca));
+        int i = differs(shown.data(), cooked, n);
+        if ( i >= 0 )
+          fail(trial, step, "scrolled widget differs", i, columns);
+      }
+
+      last.resize(n);
+      memcpy(last.data(), cooked, n * sizeof(ca));
+      fullCook(screen, full);
+      int i = differs(last.data(), full.data(), n);
+      if ( i >= 0 )
+        fail(trial, step, "incremental image differs", i, columns);
+
+      fullCook(single, other);
+      if ( (int)other.size() != n )
+        fail(trial, step, "character at a time screen has another size", 0, columns);
+      else if ( (i = differs(full.data(), other.data(), n)) >= 0 )
+        fail(trial, step, "character at a time screen differs", i, columns);
+      else if ( screen.getCursorX() != single.getCursorX() ||
+                screen.getCursorY() != single.getCursorY() )
+        fail(trial, step, "character at a time cursor differs",
+             single.getCursorY()*columns + single.getCursorX(), columns);
+
+      // the widget repaints everything after the full cook
+      memcpy(shown.data(), full.data(), n * sizeof(ca));
+      lastGeneration = screen.generation();
+      haveShown = true;
+      checks++;
+    }
+  }
+
+  if ( failures )
+  {
+    fprintf(stderr, "%d checks failed\n", failures);
+    return 1;
+  }
+  printf("%ld images checked, %ld of them scrolled\n", checks, scrolls);
+
+  // Bare newlines at the bottom of the screen, and a log: a full line
+  // of text per newline, with 1000 lines of history and the image
+  // cooked every 5 lines as the widget would.
+  unsigned short text[132];
+  for ( int i = 0; i < 132; i++ )
+    text[i] = 'a' + i % 26;
+  static const int heights[] = { 25, 50, 100, 200 };
+  printf("lines   newline ns/line   log ns/line\n");
+  for ( unsigned h = 0; h < sizeof(heights) / sizeof(heights[0]); h++ )
+  {
+    TEScreen bare(heights[h], 132);
+    bare.setCursorYX(heights[h], 1);
+    double start = now();
+    for ( int i = 0; i < FLOOD_LINES; i++ )
+      bare.NewLine();
+    double newlines = now() - start;
+
+    TEScreen log(heights[h], 132);
+    log.setScroll(HistoryTypeBuffer(1000));
+    start = now();
+    for ( int i = 0; i < FLOOD_LINES; i++ )
+    {
+      log.ShowCharacters(text, 132);
+      log.NewLine();
+      if ( i % 5 == 4 )
+        log.getCookedImage();
+    }
+    double logs = now() - start;
+
+    printf("%5d   %15.1f   %11.1f\n", heights[h],
+           newlines * 1e9 / FLOOD_LINES, logs * 1e9 / FLOOD_LINES);
+  }
+  return 0;
+}
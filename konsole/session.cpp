@@ -20,6 +20,10 @@
       
 #include "session.h"
 #include "zmodem_dialog.h"
+#include "TECapture.h"
+#include "TEReplay.h"
+#include "TELoopback.h"
+#include "TEClock.h"
 
 #include <kdebug.h>
 #include <dcopclient.h>
@@ -32,6 +36,7 @@
 #include <kstandarddirs.h>
 
 #include <stdlib.h>
+#include <unistd.h>
 #include <qfile.h>
 #include <qdir.h>
 #include <qregexp.h>
@@ -67,9 +72,17 @@ TESession::TESession(TEWidget* _te, const QString &_device, ulong _winId,
    , zmodemBusy(false)
    , zmodemProc(0)
    , zmodemProgress(0)
+   , capture(0)
+   , replay(0)
+   , loopback(0)
+   , share(0)
+   , sharePolicy(TEShareServer::DropData)
+   , timeReceive(false)
+   , rcvBlocks(0)
+   , rcvUsecs(0)
    , encoding_no(0)
 {
-  //kdDebug(1211)<<"TESession ctor() new TETty"<<endl;
+  //kdDebug(1211)<<"TESession ctor() new TETransport"<<endl;
   te = _te;
   //kdDebug(1211)<<"TESession ctor() new TEmuVt102"<<endl;
   em = new TEmuVt102(te);
@@ -80,7 +93,7 @@ TESession::TESession(TEWidget* _te, const QString &_device, ulong _winId,
   QObject::connect(te,SIGNAL(changedFontMetricSignal(int,int)),
                    this,SLOT(onFontMetricChange(int,int)));
 
-  setPty( new TETty(device) );
+  setPty( TETransport::create(device) );
 
   connect( em, SIGNAL( changeTitle( int, const QString & ) ),
            this, SLOT( setUserTitle( int, const QString & ) ) );
@@ -97,12 +110,13 @@ TESession::TESession(TEWidget* _te, const QString &_device, ulong _winId,
   //kdDebug(1211)<<"TESession ctor() done"<<endl;
 }
 
-void TESession::setPty(TETty *_sh)
+void TESession::setPty(TETransport *_sh)
 {
   if ( sh ) {
     delete sh;
   }
   sh = _sh;
+  sh->setCapture(capture);
 
   //kdDebug(1211)<<"TESession ctor() sh->setSize()"<<endl;
   sh->setSize(te->Lines(),te->Columns()); // not absolutely nessesary
@@ -110,12 +124,16 @@ void TESession::setPty(TETty *_sh)
   //kdDebug(1211)<<"TESession ctor() connecting"<<endl;
   connect( sh,SIGNAL(block_in(const char*,int)),this,SLOT(onRcvBlock(const char*,int)) );
 
-  connect( em,SIGNAL(sndBlock(const char*,int)),sh,SLOT(send_bytes(const char*,int)) );
+  if ( !replay || !replay->isRunning() )
+    connect( em,SIGNAL(sndBlock(const char*,int)),sh,SLOT(send_bytes(const char*,int)) );
   connect( em,SIGNAL(useUtf8(bool)),sh,SLOT(useUtf8(bool)) );
+  connect( sh,SIGNAL(speedDetected(int)),this,SLOT(onSpeedDetected(int)) );
+  if ( share )
+    connect( sh,SIGNAL(lowWatermark()),share,SLOT(resumeInput()) );
 
   if (!sh->error().isEmpty()) {
-    KMessageBox::error( te->topLevelWidget(),
-			i18n("Serielle Konsole is unable to open the specified TTY.  It is likely that this is due to an incorrect configuration of the TTY devices.  Serielle Konsole needs to have read/write access to the TTY devices."), i18n("A Fatal Error Has Occurred") );
+    KMessageBox::detailedError( te->topLevelWidget(),
+			i18n("Serielle Konsole is unable to open the specified TTY.  It is likely that this is due to an incorrect configuration of the TTY devices.  Serielle Konsole needs to have read/write access to the TTY devices."), sh->error(), i18n("A Fatal Error Has Occurred") );
     emit done(this);
   }
 }
@@ -237,6 +255,215 @@ bool TESession::sendBreak()
   return sh->sendBreak();
 }
 
+/*!
+    Starts detecting the speed of the line; speedDetected() tells the
+    outcome. Returns false if the line can't do that.
+*/
+bool TESession::detectSpeed()
+{
+  return sh->startAutoBaud();
+}
+
+void TESession::onSpeedDetected(int speed)
+{
+  emit speedDetected(this, speed);
+}
+
+/*!
+    Starts recording the raw traffic of the line into \a file, replacing
+    a capture already running.
+*/
+bool TESession::startCapture(const QString &file)
+{
+  stopCapture();
+
+  capture = new TECaptureWriter();
+  if ( !capture->open(file) ) {
+    delete capture;
+    capture = 0;
+    return false;
+  }
+  sh->setCapture(capture);
+  return true;
+}
+
+void TESession::stopCapture()
+{
+  if ( !capture ) return;
+
+  if ( sh )
+    sh->setCapture(0);
+  delete capture;
+  capture = 0;
+}
+
+bool TESession::isCapturing()
+{
+  return capture != 0;
+}
+
+/*!
+    Lets other programs attach to the line through a UNIX domain socket
+    at \a path, or at a socket in the KDE socket directory if empty.
+    Replaces sharing already going on.
+*/
+bool TESession::startSharing(const QString &path)
+{
+  stopSharing();
+
+  QString socket = path;
+  if ( socket.isEmpty() )
+    socket = locateLocal("socket", QString("serielle-konsole-%1-%2").arg(getpid()).arg(sessionId));
+
+  share = new TEShareServer(this);
+  share->setPolicy(sharePolicy);
+  if ( !share->listen(socket) ) {
+    shareErr = share->error();
+    delete share;
+    share = 0;
+    return false;
+  }
+  shareErr = QString::null;
+
+  connect( share,SIGNAL(received(const char*,int)),this,SLOT(onShareBlock(const char*,int)) );
+  addTap(share);
+  connect( sh,SIGNAL(lowWatermark()),share,SLOT(resumeInput()) );
+  return true;
+}
+
+void TESession::stopSharing()
+{
+  if ( !share ) return;
+
+  removeTap(share);
+  delete share;
+  share = 0;
+}
+
+QString TESession::sharePath()
+{
+  return share ? share->path() : QString::null;
+}
+
+/*!
+    Plays the received data of a capture file or byte dump into the
+    emulation, see TEReplay::start().
+*/
+bool TESession::replayCapture(const QString &file, double speed)
+{
+  if ( !replay ) {
+    replay = new TEReplay(em, this);
+    connect( replay,SIGNAL(finished()),this,SLOT(onReplayFinished()) );
+  }
+  bool wasRunning = replay->isRunning();
+  if ( !replay->start(file, speed) ) {
+    if ( wasRunning )
+      onReplayFinished();
+    return false;
+  }
+
+  // The emulation answers the queries in the capture; those answers,
+  // and keys typed meanwhile, must not go out on the line.
+  if ( !wasRunning )
+    disconnect( em,SIGNAL(sndBlock(const char*,int)),sh,SLOT(send_bytes(const char*,int)) );
+  return true;
+}
+
+void TESession::onReplayFinished()
+{
+  connect( em,SIGNAL(sndBlock(const char*,int)),sh,SLOT(send_bytes(const char*,int)) );
+}
+
+void TESession::setLoopback(TELoopback *_loopback)
+{
+  loopback = _loopback;
+  connect( loopback,SIGNAL(verifyFailed(const QString&)),this,SLOT(onLoopbackFailed(const QString&)) );
+}
+
+void TESession::onLoopbackFailed(const QString &status)
+{
+  KNotifyClient::event(winId, "LoopbackFailed",
+                       i18n("Loopback check failed in session '%1': %2").arg(title).arg(status));
+}
+
+/*!
+    Measures the emulation pipeline on a capture file, see
+    TEReplay::benchmark(), with the settings of this session. The
+    session itself is not touched.
+*/
+QString TESession::benchmarkCapture(const QString &file)
+{
+  return TEReplay::benchmark(file, em->codec(), em->legacyParser(),
+                             em->imageSize(), te->getVTFont());
+}
+
+/*!
+    Returns the I/O counters of the session as "name: value" lines.
+
+    Apart from the time spent in the emulation everything is counted
+    all the time; that one is only measured from the first call on,
+    so that sessions nobody looks at don't pay for the clock.
+*/
+QString TESession::statistics()
+{
+  QString report;
+  const TETransportStats &st = sh->stats();
+
+  report += QString("device: %1\n").arg(sh->name());
+  if ( !sh->peerName().isEmpty() )
+    report += QString("peer: %1\n").arg(sh->peerName());
+  report += QString("bytes_in: %1\n").arg(st.bytesIn);
+  report += QString("bytes_out: %1\n").arg(st.bytesOut);
+  report += QString("read_calls: %1\n").arg(st.readCalls);
+  report += QString("write_calls: %1\n").arg(st.writeCalls);
+  report += QString("read_wakeups: %1\n").arg(sh->readWakeups());
+  report += QString("write_wakeups: %1\n").arg(sh->writeWakeups());
+  report += QString("bytes_per_wakeup: %1\n").arg(sh->bytesPerWakeup(), 0, 'f', 1);
+
+  // bytes per read, one "size:count" pair per used power of two
+  report += "read_sizes:";
+  for ( int i = 0; i < TESTATS_READ_BUCKETS; i++ )
+    if ( st.readSizes[i] )
+      report += QString(" %1%2:%3").arg(1 << i).arg(i == TESTATS_READ_BUCKETS-1 ? "+" : "")
+                                   .arg(st.readSizes[i]);
+  report += "\n";
+
+  if ( timeReceive ) {
+    report += QString("emulation_blocks: %1\n").arg(rcvBlocks);
+    report += QString("emulation_usecs: %1\n").arg(rcvUsecs);
+  }
+  else {
+    timeReceive = true;
+    report += "emulation_usecs: not measured yet\n";
+  }
+
+  report += QString("frames: %1\n").arg(em->framesShown());
+  report += QString("frames_skipped: %1\n").arg(em->skippedFrames());
+  report += QString("frames_per_sec: %1\n").arg(em->framesPerSecond(), 0, 'f', 1);
+
+  TELineCounters lc;
+  if ( sh->lineCounters(&lc) ) {
+    report += QString("uart_rx: %1\n").arg(lc.rx);
+    report += QString("uart_tx: %1\n").arg(lc.tx);
+    report += QString("uart_overrun: %1\n").arg(lc.overrun);
+    report += QString("uart_framing: %1\n").arg(lc.frame);
+    report += QString("uart_parity: %1\n").arg(lc.parity);
+    report += QString("uart_break: %1\n").arg(lc.brk);
+    report += QString("uart_buffer_overrun: %1\n").arg(lc.bufOverrun);
+  }
+
+  if ( loopback )
+    report += QString("loopback: %1\n").arg(loopback->status());
+
+  if ( share ) {
+    report += QString("share_path: %1\n").arg(share->path());
+    report += QString("share_clients: %1\n").arg(share->clients());
+    report += QString("share_dropped: %1\n").arg(share->dropped());
+  }
+
+  return report;
+}
+
 bool TESession::closeSession()
 {
   emit done();
@@ -268,6 +495,11 @@ void TESession::renameSession(const QString &name)
 TESession::~TESession()
 {
  //kdDebug(1211) << "disconnnecting..." << endl;
+  stopCapture();
+  stopSharing();
+  delete replay;
+  // Nothing the line still delivers may reach the emulation once it is gone.
+  sh->disconnect();
   delete em;
   delete sh;
 
@@ -509,7 +741,7 @@ void TESession::startZModem(const QString &zmodem, const QString &dir, const QSt
 
   disconnect( sh,SIGNAL(block_in(const char*,int)), this, SLOT(onRcvBlock(const char*,int)) );
   connect( sh,SIGNAL(block_in(const char*,int)), this, SLOT(zmodemRcvBlock(const char*,int)) );
-  connect( sh,SIGNAL(buffer_empty()), this, SLOT(zmodemContinue()));
+  connect( sh,SIGNAL(lowWatermark()), this, SLOT(zmodemContinue()));
 
   zmodemProgress = new ZModemDialog(te->topLevelWidget(), false,
                                     i18n("ZModem Progress"));
@@ -581,7 +813,7 @@ void TESession::zmodemDone()
     zmodemBusy = false;
 
     disconnect( sh,SIGNAL(block_in(const char*,int)), this ,SLOT(zmodemRcvBlock(const char*,int)) );
-    disconnect( sh,SIGNAL(buffer_empty()), this, SLOT(zmodemContinue()));
+    disconnect( sh,SIGNAL(lowWatermark()), this, SLOT(zmodemContinue()));
     connect( sh,SIGNAL(block_in(const char*,int)), this, SLOT(onRcvBlock(const char*,int)) );
 
     sh->send_bytes("\030\030\030\030", 4); // Abort
@@ -632,8 +864,28 @@ QCStringList TESession::functionsDynamic()
 
 void TESession::onRcvBlock( const char* buf, int len )
 {
-    em->onRcvBlock( buf, len );
-    emit receivedData( QString::fromLatin1( buf, len ) );
+    if ( timeReceive ) {
+      unsigned long long start = now();
+      em->onRcvBlock( buf, len );
+      rcvUsecs += now() - start;
+      rcvBlocks++;
+    }
+    else
+      em->onRcvBlock( buf, len );
+    if ( !taps.isEmpty() )
+      taps.dispatch( buf, len, em->codec() );
+}
+
+/*!
+    Data written by a program the session is shared with. It shares the
+    transmit queue with the keyboard; while the queue is full the
+    programs are not read from.
+*/
+void TESession::onShareBlock( const char* buf, int len )
+{
+    sh->send_bytes( buf, len );
+    if ( sh->buffer_full() )
+      share->suspendInput();
 }
 
 void TESession::print( QPainter &paint, bool friendly, bool exact )
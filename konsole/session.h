@@ -25,7 +25,9 @@
 #include <kmainwindow.h>
 #include <qstrlist.h>
 
-#include "TETty.h"
+#include "TETransport.h"
+#include "TEShareServer.h"
+#include "TETap.h"
 #include "TEWidget.h"
 #include "TEmuVt102.h"
 
@@ -35,6 +37,10 @@ class KProcIO;
 class KProcess;
 class ZModemDialog;
 
+class TECaptureWriter;
+class TEReplay;
+class TELoopback;
+
 class TESession : public QObject, virtual public SessionIface
 { Q_OBJECT
 
@@ -43,8 +49,9 @@ public:
   TESession(TEWidget* w, const QString &device,
 	    ulong winId, const QString &sessionId="session-1");
   void changeWidget(TEWidget* w);
-  void setPty( TETty *_sh );
+  void setPty( TETransport *_sh );
   TEWidget* widget() { return te; }
+  TETransport* transport() { return sh; }
   ~TESession();
 
   void        setConnect(bool r);  // calls setListenToKeyPress(r)
@@ -96,12 +103,34 @@ public:
   void enableFullScripting(bool b) { fullScripting = b; }
 
   bool sendBreak();
+  bool detectSpeed();
   void startZModem(const QString &rz, const QString &dir, const QStringList &list);
   void cancelZModem();
   bool zmodemIsBusy() { return zmodemBusy; }
 
   void print(QPainter &paint, bool friendly, bool exact);
 
+  bool startCapture(const QString &file);
+  void stopCapture();
+  bool isCapturing();
+  bool replayCapture(const QString &file, double speed);
+  QString benchmarkCapture(const QString &file);
+
+  QString statistics();
+
+  /*! reports the state of \a loopback, which drives this session, in
+      statistics() and notifies when its check fails */
+  void setLoopback(TELoopback *loopback);
+
+  /*! lets \a tap see the received data, until removeTap() */
+  void addTap(TETap *tap) { taps.add(tap); }
+  void removeTap(TETap *tap) { taps.remove(tap); }
+
+  bool startSharing(const QString &path);
+  void stopSharing();
+  QString sharePath();
+  QString shareError() { return shareErr; }
+
   QString schema();
   void setSchema(const QString &schema);
   QString encoding();
@@ -129,13 +158,13 @@ public slots:
   void zmodemDone();
   void zmodemContinue();
 
-  void setFlowControl(TETty::FlowControl flow)
+  void setFlowControl(TETransport::FlowControl flow)
   { sh->setFlowControl(flow); }
 
   void setSpeed(int speed)
   { sh->setSpeed(speed); }
 
-  void setParity(TETty::Parity parity)
+  void setParity(TETransport::Parity parity)
   { sh->setParity(parity); }
 
   void setBits(uint8_t bits)
@@ -144,9 +173,23 @@ public slots:
   void setStopBits(uint8_t stopbits)
   { sh->setStopBits(stopbits); }
 
+  void setReadBatchLimit(int bytes)
+  { sh->setReadBatchLimit(bytes); }
+
+  void setThreaded(bool on)
+  { sh->setThreaded(on); }
+
+  void setLatencyProfile(TETransport::LatencyProfile profile)
+  { sh->setLatencyProfile(profile); }
+
+  void setReadCoalesce(int msecs)
+  { sh->setReadCoalesce(msecs); }
+
+  void setSharePolicy(TEShareServer::Policy policy)
+  { sharePolicy = policy; if (share) share->setPolicy(policy); }
+
 signals:
 
-  void receivedData( const QString& text );
   void done(TESession*);
   void updateTitle(TESession*);
   void notifySessionState(TESession* session, int state);
@@ -159,6 +202,7 @@ signals:
   void openURLRequest(const QString &cwd);
 
   void zmodemDetected(TESession *);
+  void speedDetected(TESession *, int speed);
   void updateSessionConfig(TESession *);
   void resizeSession(TESession *session, QSize size);
   void setSessionEncoding(TESession *session, const QString &encoding);
@@ -167,6 +211,10 @@ signals:
 
 private slots:
   void onRcvBlock( const char* buf, int len );
+  void onSpeedDetected(int speed);
+  void onReplayFinished();
+  void onLoopbackFailed(const QString &status);
+  void onShareBlock( const char* buf, int len );
   void monitorTimerDone();
   void notifySessionState(int state);
   void onContentSizeChange(int height, int width);
@@ -174,7 +222,7 @@ private slots:
 
 private:
 
-  TETty*         sh;
+  TETransport*   sh;
   TEWidget*      te;
   TEmulation*    em;
 
@@ -213,6 +261,20 @@ private:
   KProcIO*       zmodemProc;
   ZModemDialog*  zmodemProgress;
 
+  TECaptureWriter* capture;
+  TEReplay*      replay;
+  TELoopback*    loopback;
+
+  TETapList      taps;
+  TEShareServer* share;
+  TEShareServer::Policy sharePolicy;
+  QString        shareErr;
+
+  // time spent in the emulation, measured once statistics() was asked for
+  bool           timeReceive;
+  unsigned long  rcvBlocks;
+  unsigned long long rcvUsecs;
+
   // Color/Font Changes by ESC Sequences
 
   QColor         modifiedBackground; // as set by: echo -en '\033]11;Color\007
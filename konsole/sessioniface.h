@@ -30,6 +30,18 @@ class SessionIface : virtual public DCOPObject
 
     virtual bool closeSession() =0;
     virtual bool sendBreak() =0;
+    virtual bool detectSpeed() =0;
+
+    virtual bool startCapture(const QString &file) =0;
+    virtual void stopCapture() =0;
+    virtual bool isCapturing() =0;
+    virtual bool replayCapture(const QString &file, double speed) =0;
+    virtual QString benchmarkCapture(const QString &file) =0;
+    virtual QString statistics() =0;
+
+    virtual bool startSharing(const QString &path) =0;
+    virtual void stopSharing() =0;
+    virtual QString sharePath() =0;
 
     virtual void clearHistory() =0;
     virtual void renameSession(const QString &name) =0;
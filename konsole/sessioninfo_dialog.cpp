@@ -0,0 +1,68 @@
+/*
+    This file is part of Konsole, an X terminal.
+    Copyright (C) 2007 Diego Pettenò <flameeyes@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+#include "sessioninfo_dialog.h"
+#include "session.h"
+
+#include <qtextedit.h>
+#include <qtimer.h>
+
+#include <kglobalsettings.h>
+#include <klocale.h>
+
+SessionInfoDialog::SessionInfoDialog(QWidget *parent, TESession *_session)
+ : KDialogBase(parent, "session_info", false,
+   i18n("Session Statistics - %1").arg(_session->Title()),
+   Close, Close, true)
+ , session(_session)
+{
+  textEdit = new QTextEdit(this);
+  textEdit->setReadOnly(true);
+  textEdit->setTextFormat(Qt::PlainText);
+  textEdit->setFont(KGlobalSettings::fixedFont());
+  textEdit->setMinimumSize(400, 300);
+  setMainWidget(textEdit);
+
+  timer = new QTimer(this);
+  connect(timer, SIGNAL(timeout()), this, SLOT(refresh()));
+
+  refresh();
+  timer->start(1000);
+}
+
+void SessionInfoDialog::refresh()
+{
+  if (!session) {
+    timer->stop();
+    textEdit->setText(i18n("The session has been closed."));
+    return;
+  }
+
+  textEdit->setText(session->statistics());
+}
+
+void SessionInfoDialog::slotClose()
+{
+  timer->stop();
+  KDialogBase::slotClose();
+  delayedDestruct();
+}
+
+#include "sessioninfo_dialog.moc"
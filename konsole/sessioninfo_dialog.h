@@ -0,0 +1,50 @@
+/*
+    This file is part of Konsole, an X terminal.
+    Copyright (C) 2007 Diego Pettenò <flameeyes@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+#ifndef SESSIONINFO_DIALOG_H
+#define SESSIONINFO_DIALOG_H
+
+#include <kdialogbase.h>
+#include <qguardedptr.h>
+
+class QTextEdit;
+class QTimer;
+class TESession;
+
+/*!
+    Shows the I/O statistics of a session, refreshed every second.
+*/
+class SessionInfoDialog : public KDialogBase
+{
+  Q_OBJECT
+public:
+  SessionInfoDialog(QWidget *parent, TESession *session);
+
+public slots:
+  void refresh();
+  void slotClose();
+
+private:
+  QGuardedPtr<TESession> session;
+  QTextEdit *textEdit;
+  QTimer *timer;
+};
+
+#endif
@@ -0,0 +1,199 @@
+/*
+    This file is part of Konsole, an X terminal.
+    Copyright (C) 2007 Diego Pettenò <flameeyes@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+/*
+   Writes the transition table of the DEC/ANSI parser in TEVt500Parser
+   to standard output, as vt500table.h.
+
+   The state machine is the one of the VT500 series as described by
+   Paul Flo Williams ("A parser for DEC's ANSI-compatible video
+   terminals"), with two changes: a BEL ends an OSC string as it does
+   in xterm, and ':' separates parameters like ';'.
+
+   Every entry of the table is one byte: the action in the high nibble
+   and the next state in the low one, STAY if the state does not
+   change. Leaving a state and entering one may run an action of their
+   own, listed in the exit and entry tables.
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "TEVt500States.h"
+
+// One column for each character up to 0x9f, and one for everything
+// above: GR and the rest of Unicode.
+#define COLUMNS (VT500_GR + 1)
+
+static unsigned char table[VT500_STATES][COLUMNS];
+static unsigned char entry[VT500_STATES];
+static unsigned char exit_[VT500_STATES];
+
+static const char *stateNames[VT500_STATES] = {
+  "GROUND", "ESCAPE", "ESCAPE_INTERMEDIATE", "CSI_ENTRY", "CSI_PARAM",
+  "CSI_INTERMEDIATE", "CSI_IGNORE", "DCS_ENTRY", "DCS_PARAM",
+  "DCS_INTERMEDIATE", "DCS_PASSTHROUGH", "DCS_IGNORE", "OSC_STRING",
+  "SOS_PM_APC_STRING"
+};
+
+static void set(int state, int from, int to, int action, int next)
+{
+  for ( int c = from; c <= to; c++ )
+    table[state][c] = (action << 4) | next;
+}
+
+static void event(int state, int from, int to, int action)
+{
+  set(state, from, to, action, VT500_STAY);
+}
+
+// C0 controls, without CAN, SUB and ESC which act anywhere
+static void c0(int state, int action)
+{
+  event(state, 0x00, 0x17, action);
+  event(state, 0x19, 0x19, action);
+  event(state, 0x1c, 0x1f, action);
+}
+
+static void anywhere(int state)
+{
+  set(state, 0x18, 0x18, VT500_EXECUTE, VT500_GROUND);
+  set(state, 0x1a, 0x1a, VT500_EXECUTE, VT500_GROUND);
+  set(state, 0x1b, 0x1b, VT500_NONE, VT500_ESCAPE);
+
+  set(state, 0x80, 0x8f, VT500_EXECUTE, VT500_GROUND);
+  set(state, 0x90, 0x90, VT500_NONE, VT500_DCS_ENTRY);
+  set(state, 0x91, 0x97, VT500_EXECUTE, VT500_GROUND);
+  set(state, 0x98, 0x98, VT500_NONE, VT500_SOS_PM_APC_STRING);
+  set(state, 0x99, 0x9a, VT500_EXECUTE, VT500_GROUND);
+  set(state, 0x9b, 0x9b, VT500_NONE, VT500_CSI_ENTRY);
+  set(state, 0x9c, 0x9c, VT500_NONE, VT500_GROUND);
+  set(state, 0x9d, 0x9d, VT500_NONE, VT500_OSC_STRING);
+  set(state, 0x9e, 0x9f, VT500_NONE, VT500_SOS_PM_APC_STRING);
+}
+
+static void build()
+{
+  for ( int s = 0; s < VT500_STATES; s++ )
+  {
+    event(s, 0, COLUMNS-1, VT500_IGNORE);
+    anywhere(s);
+    // DEL is ignored everywhere
+    event(s, 0x7f, 0x7f, VT500_IGNORE);
+    entry[s] = exit_[s] = VT500_NONE;
+  }
+
+  entry[VT500_ESCAPE] = VT500_CLEAR;
+  entry[VT500_CSI_ENTRY] = VT500_CLEAR;
+  entry[VT500_DCS_ENTRY] = VT500_CLEAR;
+  entry[VT500_OSC_STRING] = VT500_OSC_START;
+  exit_[VT500_OSC_STRING] = VT500_OSC_END;
+
+  c0(VT500_GROUND, VT500_EXECUTE);
+  event(VT500_GROUND, 0x20, 0x7e, VT500_PRINT);
+  event(VT500_GROUND, VT500_GR, VT500_GR, VT500_PRINT);
+
+  c0(VT500_ESCAPE, VT500_EXECUTE);
+  set(VT500_ESCAPE, 0x20, 0x2f, VT500_COLLECT, VT500_ESCAPE_INTERMEDIATE);
+  set(VT500_ESCAPE, 0x30, 0x7e, VT500_ESC_DISPATCH, VT500_GROUND);
+  set(VT500_ESCAPE, 0x50, 0x50, VT500_NONE, VT500_DCS_ENTRY);
+  set(VT500_ESCAPE, 0x58, 0x58, VT500_NONE, VT500_SOS_PM_APC_STRING);
+  set(VT500_ESCAPE, 0x5b, 0x5b, VT500_NONE, VT500_CSI_ENTRY);
+  set(VT500_ESCAPE, 0x5d, 0x5d, VT500_NONE, VT500_OSC_STRING);
+  set(VT500_ESCAPE, 0x5e, 0x5f, VT500_NONE, VT500_SOS_PM_APC_STRING);
+  set(VT500_ESCAPE, VT500_GR, VT500_GR, VT500_NONE, VT500_GROUND);
+
+  c0(VT500_ESCAPE_INTERMEDIATE, VT500_EXECUTE);
+  event(VT500_ESCAPE_INTERMEDIATE, 0x20, 0x2f, VT500_COLLECT);
+  set(VT500_ESCAPE_INTERMEDIATE, 0x30, 0x7e, VT500_ESC_DISPATCH, VT500_GROUND);
+
+  c0(VT500_CSI_ENTRY, VT500_EXECUTE);
+  set(VT500_CSI_ENTRY, 0x20, 0x2f, VT500_COLLECT, VT500_CSI_INTERMEDIATE);
+  set(VT500_CSI_ENTRY, 0x30, 0x3b, VT500_PARAM, VT500_CSI_PARAM);
+  set(VT500_CSI_ENTRY, 0x3c, 0x3f, VT500_COLLECT, VT500_CSI_PARAM);
+  set(VT500_CSI_ENTRY, 0x40, 0x7e, VT500_CSI_DISPATCH, VT500_GROUND);
+
+  c0(VT500_CSI_PARAM, VT500_EXECUTE);
+  event(VT500_CSI_PARAM, 0x30, 0x3b, VT500_PARAM);
+  set(VT500_CSI_PARAM, 0x3c, 0x3f, VT500_NONE, VT500_CSI_IGNORE);
+  set(VT500_CSI_PARAM, 0x20, 0x2f, VT500_COLLECT, VT500_CSI_INTERMEDIATE);
+  set(VT500_CSI_PARAM, 0x40, 0x7e, VT500_CSI_DISPATCH, VT500_GROUND);
+
+  c0(VT500_CSI_INTERMEDIATE, VT500_EXECUTE);
+  event(VT500_CSI_INTERMEDIATE, 0x20, 0x2f, VT500_COLLECT);
+  set(VT500_CSI_INTERMEDIATE, 0x30, 0x3f, VT500_NONE, VT500_CSI_IGNORE);
+  set(VT500_CSI_INTERMEDIATE, 0x40, 0x7e, VT500_CSI_DISPATCH, VT500_GROUND);
+
+  c0(VT500_CSI_IGNORE, VT500_EXECUTE);
+  set(VT500_CSI_IGNORE, 0x40, 0x7e, VT500_NONE, VT500_GROUND);
+
+  // Device control strings are parsed, but nothing is done with them.
+  set(VT500_DCS_ENTRY, 0x20, 0x2f, VT500_COLLECT, VT500_DCS_INTERMEDIATE);
+  set(VT500_DCS_ENTRY, 0x30, 0x3b, VT500_PARAM, VT500_DCS_PARAM);
+  set(VT500_DCS_ENTRY, 0x3c, 0x3f, VT500_COLLECT, VT500_DCS_PARAM);
+  set(VT500_DCS_ENTRY, 0x40, 0x7e, VT500_NONE, VT500_DCS_PASSTHROUGH);
+
+  event(VT500_DCS_PARAM, 0x30, 0x3b, VT500_PARAM);
+  set(VT500_DCS_PARAM, 0x3c, 0x3f, VT500_NONE, VT500_DCS_IGNORE);
+  set(VT500_DCS_PARAM, 0x20, 0x2f, VT500_COLLECT, VT500_DCS_INTERMEDIATE);
+  set(VT500_DCS_PARAM, 0x40, 0x7e, VT500_NONE, VT500_DCS_PASSTHROUGH);
+
+  event(VT500_DCS_INTERMEDIATE, 0x20, 0x2f, VT500_COLLECT);
+  set(VT500_DCS_INTERMEDIATE, 0x30, 0x3f, VT500_NONE, VT500_DCS_IGNORE);
+  set(VT500_DCS_INTERMEDIATE, 0x40, 0x7e, VT500_NONE, VT500_DCS_PASSTHROUGH);
+
+  event(VT500_OSC_STRING, 0x20, 0x7e, VT500_OSC_PUT);
+  event(VT500_OSC_STRING, VT500_GR, VT500_GR, VT500_OSC_PUT);
+  set(VT500_OSC_STRING, 0x07, 0x07, VT500_NONE, VT500_GROUND);
+}
+
+static void dumpRow(const unsigned char *row, int len)
+{
+  for ( int c = 0; c < len; c++ )
+    printf("%s0x%02x,%s", c % 12 ? " " : "    ", row[c], c % 12 == 11 || c == len-1 ? "\n" : "");
+}
+
+int main()
+{
+  build();
+
+  printf("/* Generated by vt500gen, do not edit. */\n\n");
+  printf("#ifndef VT500TABLE_H\n#define VT500TABLE_H\n\n");
+
+  printf("static const unsigned char vt500_table[%d][%d] = {\n", VT500_STATES, COLUMNS);
+  for ( int s = 0; s < VT500_STATES; s++ )
+  {
+    printf("  { // %s\n", stateNames[s]);
+    dumpRow(table[s], COLUMNS);
+    printf("  },\n");
+  }
+  printf("};\n\n");
+
+  printf("static const unsigned char vt500_entry[%d] = {\n", VT500_STATES);
+  dumpRow(entry, VT500_STATES);
+  printf("};\n\n");
+
+  printf("static const unsigned char vt500_exit[%d] = {\n", VT500_STATES);
+  dumpRow(exit_, VT500_STATES);
+  printf("};\n\n");
+
+  printf("#endif // VT500TABLE_H\n");
+  return 0;
+}
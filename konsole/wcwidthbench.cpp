@@ -0,0 +1,90 @@
+/*
+    This file is part of Konsole, an X terminal.
+    Copyright (C) 2007 Diego Pettenò <flameeyes@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+/*
+ * Checks the table of konsole_wcwidth() against the interval tables it
+ * was generated from, for every character, and times both.
+ */
+
+#include <stdio.h>
+#include <sys/time.h>
+
+#include "konsole_wcwidth.h"
+#include "konsole_wcwidth_intervals.h"
+
+#define ROUNDS 200
+
+static double now()
+{
+  struct timeval tv;
+  gettimeofday(&tv, 0);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static unsigned short text[65536];
+
+int main()
+{
+  int errors = 0;
+  for ( int c = 0; c < 65536; c++ )
+    if ( konsole_wcwidth(c) != interval_wcwidth(c) )
+    {
+      if ( errors++ < 10 )
+        fprintf(stderr, "U+%04X: %d, should be %d\n", c,
+                konsole_wcwidth(c), interval_wcwidth(c));
+    }
+  if ( errors )
+  {
+    fprintf(stderr, "%d characters differ\n", errors);
+    return 1;
+  }
+  printf("all 65536 characters match\n");
+
+  // Mostly ASCII, with some Latin, combining marks and CJK, as a
+  // terminal would see them.
+  unsigned int seed = 1;
+  for ( int i = 0; i < 65536; i++ )
+  {
+    seed = seed * 1103515245 + 12345;
+    unsigned int r = (seed >> 16) % 100;
+    if ( r < 80 )      text[i] = 0x20 + (seed >> 8) % 95;
+    else if ( r < 90 ) text[i] = 0xa0 + (seed >> 8) % 0x180;
+    else if ( r < 93 ) text[i] = 0x300 + (seed >> 8) % 0x70;
+    else               text[i] = 0x4e00 + (seed >> 8) % 0x5000;
+  }
+
+  int sum = 0;
+  double start = now();
+  for ( int r = 0; r < ROUNDS; r++ )
+    for ( int i = 0; i < 65536; i++ )
+      sum += interval_wcwidth(text[i]);
+  double intervals = now() - start;
+
+  start = now();
+  for ( int r = 0; r < ROUNDS; r++ )
+    for ( int i = 0; i < 65536; i++ )
+      sum += konsole_wcwidth(text[i]);
+  double table = now() - start;
+
+  double n = ROUNDS * 65536.0 / 1e6;
+  printf("intervals %8.1f Mchars/s\n", n / intervals);
+  printf("table     %8.1f Mchars/s\n", n / table);
+  return sum == 0;
+}
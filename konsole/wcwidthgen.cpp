@@ -0,0 +1,78 @@
+/*
+    This file is part of Konsole, an X terminal.
+    Copyright (C) 2007 Diego Pettenò <flameeyes@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+/*
+ * Writes the width table of konsole_wcwidth() to standard output, as
+ * konsole_wcwidth_table.h.
+ *
+ * The widths of all 65536 characters come from the interval tables in
+ * konsole_wcwidth_intervals.h. They are split into pages of 256, one
+ * for each high byte, and pages with the same widths are stored once,
+ * so most of the table is a handful of pages of ones.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "konsole_wcwidth_intervals.h"
+
+static signed char blocks[256][256];
+static unsigned char pages[256];
+
+int main()
+{
+  int count = 0;
+
+  for ( int page = 0; page < 256; page++ )
+  {
+    signed char block[256];
+    for ( int i = 0; i < 256; i++ )
+      block[i] = interval_wcwidth(page << 8 | i);
+
+    int b;
+    for ( b = 0; b < count; b++ )
+      if ( memcmp(blocks[b], block, sizeof(block)) == 0 )
+        break;
+    if ( b == count )
+      memcpy(blocks[count++], block, sizeof(block));
+    pages[page] = b;
+  }
+
+  printf("/* Generated by wcwidthgen, do not edit. */\n\n");
+  printf("#ifndef _KONSOLE_WCWIDTH_TABLE_H_\n#define _KONSOLE_WCWIDTH_TABLE_H_\n\n");
+
+  printf("const unsigned char konsole_wcwidth_pages[256] = {\n");
+  for ( int i = 0; i < 256; i++ )
+    printf("%s%2d,%s", i % 16 ? " " : "  ", pages[i], i % 16 == 15 ? "\n" : "");
+  printf("};\n\n");
+
+  printf("const signed char konsole_wcwidth_blocks[%d][256] = {\n", count);
+  for ( int b = 0; b < count; b++ )
+  {
+    printf("  {\n");
+    for ( int i = 0; i < 256; i++ )
+      printf("%s%2d,%s", i % 32 ? " " : "    ", blocks[b][i], i % 32 == 31 ? "\n" : "");
+    printf("  },\n");
+  }
+  printf("};\n\n");
+
+  printf("#endif\n");
+  return 0;
+}